@@ -0,0 +1,70 @@
+"""
+    Compare per-signal and batched handlers.
+
+    /bench_batched [count]
+
+    Prints `count' lines in a scratch window and counts them with a plain
+    "print text" handler and with handlers added by signal_add_batched, 
+    then reports the time per line and how many Python calls were made.
+    Times include irssi's own handlers, so compare against the "none" line.
+"""
+
+import irssi
+import time
+
+calls = 0
+lines = 0
+
+def each_print(dest, text, stripped):
+    global calls, lines
+    calls += 1
+    lines += 1
+
+def batch_print(batch):
+    global calls, lines
+    calls += 1
+    lines += len(batch)
+
+def run_print(win, count):
+    start = time.time()
+    for i in xrange(count):
+        win.prnt('bench_batched %d' % i)
+    return (time.time() - start) * 1000000.0 / count
+
+def cmd_bench_batched(data, server, witem):
+    global calls, lines
+    count = 1000
+    if data:
+        count = int(data)
+
+    cases = [
+        ('none', None, 0),
+        ('each', each_print, 0),
+        ('batch 10', batch_print, 10),
+        ('batch 100', batch_print, 100),
+        ('batch 1000', batch_print, 1000),
+    ]
+
+    results = []
+    win = irssi.window_create(automatic=True)
+    try:
+        for name, func, size in cases:
+            calls = lines = 0
+            if func and size:
+                irssi.signal_add_batched('print text', func, size=size, msecs=0)
+            elif func:
+                irssi.signal_add('print text', func)
+            try:
+                usec = run_print(win, count)
+            finally:
+                if func:
+                    irssi.signal_remove('print text', func)
+            results.append((name, usec, calls, lines))
+    finally:
+        win.destroy()
+
+    print '%d lines' % count
+    for name, usec, ncalls, nlines in results:
+        print '%-10s %8.1f usec/line %6d calls %6d lines' % (name, usec, ncalls, nlines)
+
+irssi.command_bind('bench_batched', cmd_bench_batched)
@@ -0,0 +1,53 @@
+"""
+    Time binding and removing many dynamic signals.
+
+    /bench_bindings [count]
+
+    Adds handlers for `count' distinct "redir bench_bindings N" signals,
+    then removes them oldest first and again newest first, and repeats 
+    with twice as many. All of them share the variable "redir " signal, 
+    which indexes its proxies by name and priority, so usec/signal should 
+    stay about the same for both counts; if it doubles, adding or removing
+    is scanning the other signals.
+"""
+
+import irssi
+import time
+
+def sig_bench(*args):
+    pass
+
+def names(count):
+    return ['redir bench_bindings %d' % i for i in xrange(count)]
+
+def run_add(sigs):
+    start = time.time()
+    for name in sigs:
+        irssi.signal_add(name, sig_bench)
+    return time.time() - start
+
+def run_remove(sigs):
+    start = time.time()
+    for name in sigs:
+        irssi.signal_remove(name, sig_bench)
+    return time.time() - start
+
+def cmd_bench_bindings(data, server, witem):
+    count = 5000
+    if data:
+        count = int(data)
+
+    for n in (count, count * 2):
+        sigs = names(n)
+        rev = sigs[:]
+        rev.reverse()
+        results = [('add', run_add(sigs)), 
+                   ('remove old', run_remove(sigs))]
+        run_add(sigs)
+        results.append(('remove new', run_remove(rev)))
+
+        for name, secs in results:
+            print '%6d %-10s %8.1f ms %8.2f usec/signal' % (n, name, 
+                    secs * 1000.0, secs * 1000000.0 / n)
+
+irssi.command_bind('bench_bindings', cmd_bench_bindings)
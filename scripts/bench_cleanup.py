@@ -0,0 +1,46 @@
+"""
+    Measure the cost of destroying a record while many wrappers are alive.
+
+    /bench_cleanup [live] [events]
+
+    Keeps `live' wrappers of distinct logs around, then creates and closes
+    `events' more logs. Every "log remove" has to invalidate a wrapper, so
+    the time per event should stay flat no matter how many wrappers are 
+    live. The logs are never started, so no files are written.
+"""
+
+import irssi
+import time
+
+def new_log(i):
+    return irssi.Log('bench_cleanup-%d.log' % i)
+
+def run(live, events):
+    keep = [new_log(i) for i in xrange(live)]
+
+    start = time.time()
+    for i in xrange(events):
+        log = new_log(live + i)
+        log.close()
+    elapsed = time.time() - start
+
+    for log in keep:
+        log.close()
+    del keep
+    return elapsed * 1000000.0 / events
+
+def cmd_bench_cleanup(data, server, witem):
+    args = data.split()
+    events = 200
+    if len(args) > 1:
+        events = int(args[1])
+
+    if args:
+        sizes = [int(args[0])]
+    else:
+        sizes = [0, 100, 1000, 10000]
+
+    for live in sizes:
+        print '%6d live wrappers: %8.1f usec/destroy' % (live, run(live, events))
+
+irssi.command_bind('bench_cleanup', cmd_bench_cleanup)
@@ -0,0 +1,53 @@
+"""
+    Compare signal_emit with prebound irssi.Signal handles.
+
+    /bench_emit [count]
+
+    Registers a script signal with a no-op handler and emits it `count'
+    times with irssi.signal_emit, Signal.emit and one Signal.emit_many.
+"""
+
+import irssi
+import time
+
+SIGNAL = 'python bench emit'
+
+irssi.get_script().signal_register(SIGNAL, 'ss')
+
+def sig_bench_emit(a, b):
+    pass
+
+def run_emit(count):
+    start = time.time()
+    for i in xrange(count):
+        irssi.signal_emit(SIGNAL, 'a', 'b')
+    return start
+
+def run_handle(count):
+    sig = irssi.Signal(SIGNAL)
+    start = time.time()
+    for i in xrange(count):
+        sig.emit('a', 'b')
+    return start
+
+def run_many(count):
+    sig = irssi.Signal(SIGNAL)
+    batch = [('a', 'b')] * count
+    start = time.time()
+    sig.emit_many(batch)
+    return start
+
+def cmd_bench_emit(data, server, witem):
+    count = 10000
+    if data:
+        count = int(data)
+
+    for name, run in [('signal_emit', run_emit), 
+                      ('Signal.emit', run_handle), 
+                      ('emit_many', run_many)]:
+        start = run(count)
+        usec = (time.time() - start) * 1000000.0 / count
+        print '%-12s %8.2f usec/emit' % (name, usec)
+
+irssi.signal_add(SIGNAL, sig_bench_emit)
+irssi.command_bind('bench_emit', cmd_bench_emit)
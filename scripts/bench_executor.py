@@ -0,0 +1,73 @@
+"""
+    Measure main loop latency while the executor pool is saturated.
+
+    /bench_executor [jobs]
+
+    Samples how late a 10ms repeating timer fires for two seconds with
+    nothing else going on, then again while `jobs' blocking jobs (half
+    sleeping, half hashing) keep every python_executor_threads thread
+    busy. The late times should stay about the same.
+"""
+
+import irssi
+import time
+try:
+    from hashlib import sha1
+except ImportError:
+    from sha import new as sha1
+
+INTERVAL = 10
+SAMPLE_SECS = 2.0
+
+def job(i):
+    if i % 2:
+        time.sleep(0.1)
+    else:
+        data = 'x' * 1048576
+        for n in xrange(20):
+            sha1(data).digest()
+    return i
+
+class Sampler:
+    def __init__(self, name, next=None):
+        self.name = name
+        self.next = next
+        self.late = []
+        self.end = time.time() + SAMPLE_SECS
+        self.due = time.time() + INTERVAL / 1000.0
+        self.timer = irssi.timer(INTERVAL, self.tick, repeat=True)
+
+    def tick(self):
+        now = time.time()
+        self.late.append(max(now - self.due, 0.0))
+        self.due = now + INTERVAL / 1000.0
+        if now < self.end:
+            return
+        self.timer.cancel()
+        self.late.sort()
+        print '%-10s late avg %6.2f ms  p99 %6.2f ms  max %6.2f ms' % (self.name,
+                sum(self.late) / len(self.late) * 1000.0,
+                self.late[len(self.late) * 99 / 100] * 1000.0,
+                self.late[-1] * 1000.0)
+        if self.next:
+            self.next()
+
+def cmd_bench_executor(data, server, witem):
+    jobs = 200
+    if data:
+        jobs = int(data)
+
+    done = []
+    def finished(result):
+        done.append(result)
+        if len(done) == jobs:
+            print '%d jobs done' % jobs
+
+    def saturated():
+        for i in xrange(jobs):
+            irssi.run_in_executor(job, i, callback=finished)
+        Sampler('saturated')
+
+    Sampler('idle', saturated)
+
+irssi.command_bind('bench_executor', cmd_bench_executor)
@@ -0,0 +1,85 @@
+"""
+    Compare eager and lazy signal argument conversion.
+
+    /bench_lazy [count]
+
+    Run from a channel window. Emits "massjoin" with the channel's nick list
+    and prints `count' lines in a scratch window for "print text", first with
+    a plain handler, then with handlers added with lazy=True. Times include
+    irssi's own handlers, so compare against the "none" line.
+"""
+
+import irssi
+import time
+
+def eager_massjoin(channel, nicks):
+    pass
+
+def lazy_massjoin_first(channel, nicks):
+    if len(nicks):
+        nicks[0]
+
+def lazy_massjoin_channel(channel):
+    pass
+
+def eager_print(dest, text, stripped):
+    pass
+
+def lazy_print_dest(dest):
+    pass
+
+def run_massjoin(channel, nicks, count):
+    start = time.time()
+    for i in xrange(count):
+        irssi.signal_emit('massjoin', channel, nicks)
+    return (time.time() - start) * 1000000.0 / count
+
+def run_print(win, count):
+    start = time.time()
+    for i in xrange(count):
+        win.prnt('bench_lazy %d' % i)
+    return (time.time() - start) * 1000000.0 / count
+
+def bench(signal, run, cases):
+    results = []
+    for name, func, lazy in cases:
+        if func:
+            irssi.signal_add(signal, func, lazy=lazy)
+        try:
+            results.append((name, run()))
+        finally:
+            if func:
+                irssi.signal_remove(signal, func)
+    for name, usec in results:
+        print '%-8s %-10s %8.1f usec/emit' % (signal, name, usec)
+
+def cmd_bench_lazy(data, server, witem):
+    count = 200
+    if data:
+        count = int(data)
+
+    if not isinstance(witem, irssi.Channel):
+        print 'run this from a channel window'
+        return
+
+    nicks = witem.nicks()
+    print '%d nicks, %d emits' % (len(nicks), count)
+
+    bench('massjoin', lambda: run_massjoin(witem, nicks, count), [
+        ('none', None, False),
+        ('eager', eager_massjoin, False),
+        ('lazy[0]', lazy_massjoin_first, True),
+        ('lazy', lazy_massjoin_channel, True),
+    ])
+
+    win = irssi.window_create(automatic=True)
+    try:
+        bench('print text', lambda: run_print(win, count), [
+            ('none', None, False),
+            ('eager', eager_print, False),
+            ('lazy', lazy_print_dest, True),
+        ])
+    finally:
+        win.destroy()
+
+irssi.command_bind('bench_lazy', cmd_bench_lazy)
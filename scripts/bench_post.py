@@ -0,0 +1,45 @@
+"""
+    Measure handing results from threads back to the main loop.
+
+    /bench_post [count] [threads]
+
+    Starts `threads' threads that each post `count' calls with
+    irssi.call_soon_threadsafe, and reports the time until the main loop
+    has run all of them.
+"""
+
+import irssi
+import threading
+import time
+
+class Run:
+    def __init__(self, count, threads):
+        self.left = count * threads
+        self.start = time.time()
+        for i in xrange(threads):
+            thread = threading.Thread(target=self.worker, args=(count,))
+            thread.setDaemon(True)
+            thread.start()
+
+    def worker(self, count):
+        for i in xrange(count):
+            irssi.call_soon_threadsafe(self.done, i)
+
+    def done(self, i):
+        self.left -= 1
+        if self.left == 0:
+            print 'posted calls done in %.1f ms' % (
+                    (time.time() - self.start) * 1000.0)
+
+def cmd_bench_post(data, server, witem):
+    args = data.split()
+    count = 100000
+    threads = 4
+    if args:
+        count = int(args[0])
+    if len(args) > 1:
+        threads = int(args[1])
+
+    Run(count, threads)
+
+irssi.command_bind('bench_post', cmd_bench_post)
@@ -0,0 +1,84 @@
+"""
+    Compare io_add_watch with io_add_reader for streaming output.
+
+    /bench_reader [lines]
+
+    Forks a child that writes `lines' lines to a pipe, first read with 
+    io_add_watch and os.read plus line splitting in Python, then with 
+    irssi.io_add_reader. Reports the time taken and the number of 
+    Python calls for each.
+"""
+
+import irssi
+import os
+import time
+
+def spawn(count):
+    r, w = os.pipe()
+    pid = os.fork()
+    if pid == 0:
+        os.close(r)
+        out = os.fdopen(w, 'w')
+        for i in xrange(count):
+            out.write('line %d of some child output\n' % i)
+        out.close()
+        os._exit(0)
+
+    os.close(w)
+    irssi.pidwait_add(pid)
+    return r
+
+class Run:
+    def __init__(self, name, count, next=None):
+        self.name = name
+        self.count = count
+        self.next = next
+        self.lines = 0
+        self.calls = 0
+        self.start = time.time()
+
+    def done(self, fd):
+        os.close(fd)
+        print '%-12s %8.1f ms %8d calls %8d lines' % (self.name, 
+                (time.time() - self.start) * 1000.0, self.calls, self.lines)
+        if self.next:
+            self.next(self.count)
+
+class WatchRun(Run):
+    def __init__(self, count, next=None):
+        Run.__init__(self, 'io_add_watch', count, next)
+        self.rest = ''
+        irssi.io_add_watch(spawn(count), self.read)
+
+    def read(self, fd, condition):
+        self.calls += 1
+        data = os.read(fd, 4096)
+        if not data:
+            self.done(fd)
+            return False
+        lines = (self.rest + data).split('\n')
+        self.rest = lines.pop()
+        self.lines += len(lines)
+        return True
+
+class ReaderRun(Run):
+    def __init__(self, count, next=None):
+        Run.__init__(self, 'io_add_reader', count, next)
+        self.fd = spawn(count)
+        irssi.io_add_reader(self.fd, self.read)
+
+    def read(self, lines):
+        self.calls += 1
+        if lines is None:
+            self.done(self.fd)
+            return
+        self.lines += len(lines)
+
+def cmd_bench_reader(data, server, witem):
+    count = 200000
+    if data:
+        count = int(data)
+
+    WatchRun(count, ReaderRun)
+
+irssi.command_bind('bench_reader', cmd_bench_reader)
@@ -0,0 +1,106 @@
+"""
+    Time loading many small scripts.
+
+    /bench_startup [count] [file]
+
+    Writes `count' synthetic scripts to ~/.irssi/scripts/bench_startup_N.py,
+    loads and unloads them with the bytecode cache off, then twice with it
+    on, and deletes them. The first cached pass fills the cache and the
+    second reads from it. Results are printed and, if `file' is given, 
+    appended to it as "count<TAB>pass<TAB>ms" lines so runs can be compared.
+
+    For the startup of irssi itself, see /py startup.
+"""
+
+import irssi
+import os
+import time
+
+TEMPLATE = '''
+import irssi
+
+class Counter%(n)d(object):
+    def __init__(self):
+        self.count = 0
+
+    def add(self, n=1):
+        self.count += n
+        return self.count
+
+counter = Counter%(n)d()
+
+%(funcs)s
+
+def cmd_%(name)s(data, server, witem):
+    counter.add()
+
+def sig_%(name)s(server, msg, nick, address, target):
+    counter.add()
+
+irssi.command_bind('%(name)s', cmd_%(name)s)
+irssi.signal_add('message public', sig_%(name)s)
+'''
+
+FUNC = '''
+def helper_%(i)d(a, b=%(i)d):
+    if a > b:
+        return [x * %(i)d for x in range(a - b)]
+    return dict(a=a, b=b, i=%(i)d)
+'''
+
+def script_dir():
+    return os.path.expanduser('~/.irssi/scripts')
+
+def write_scripts(count):
+    names = []
+    for n in xrange(count):
+        name = 'bench_startup_%d' % n
+        funcs = ''.join([FUNC % {'i': i} for i in xrange(20)])
+        fp = open(os.path.join(script_dir(), name + '.py'), 'w')
+        fp.write(TEMPLATE % {'n': n, 'name': name, 'funcs': funcs})
+        fp.close()
+        names.append(name)
+    return names
+
+def load_all(names):
+    start = time.time()
+    for name in names:
+        irssi.command('py load %s' % name)
+    elapsed = time.time() - start
+    for name in names:
+        irssi.command('py unload %s' % name)
+    return elapsed * 1000.0
+
+def cmd_bench_startup(data, server, witem):
+    args = data.split()
+    count = 50
+    fname = None
+    if args:
+        count = int(args[0])
+    if len(args) > 1:
+        fname = os.path.expanduser(args[1])
+
+    cache = irssi.settings_get_bool('python_bytecode_cache')
+    names = write_scripts(count)
+    results = []
+    try:
+        irssi.settings_set_bool('python_bytecode_cache', False)
+        results.append(('compile', load_all(names)))
+        irssi.settings_set_bool('python_bytecode_cache', True)
+        results.append(('cache fill', load_all(names)))
+        results.append(('cache hit', load_all(names)))
+    finally:
+        irssi.settings_set_bool('python_bytecode_cache', cache)
+        for name in names:
+            os.unlink(os.path.join(script_dir(), name + '.py'))
+
+    for name, ms in results:
+        print '%-10s %8.1f ms total %8.2f ms/script' % (name, ms, ms / count)
+
+    if fname:
+        fp = open(fname, 'a')
+        for name, ms in results:
+            fp.write('%d\t%s\t%.1f\n' % (count, name, ms))
+        fp.close()
+
+irssi.command_bind('bench_startup', cmd_bench_startup)
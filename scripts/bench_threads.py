@@ -0,0 +1,52 @@
+"""
+    Measure how much a script thread gets done while irssi is idle or busy.
+
+    /bench_threads [seconds] [lines]
+
+    Starts a thread that hashes a buffer for `seconds' and reports the
+    throughput, with irssi left waiting for input meanwhile. With `lines',
+    irssi prints that many lines from /exec at the same time, which is all
+    its own work with no Python handler in between. The main thread only
+    holds the GIL while a handler runs, so on more than one CPU the busy 
+    figure should stay close to the idle one.
+"""
+
+import irssi
+import threading
+import time
+try:
+    from hashlib import sha1
+except ImportError:
+    from sha import new as sha1
+
+def worker(secs, result):
+    data = 'x' * 65536
+    count = 0
+    end = time.time() + secs
+    while time.time() < end:
+        sha1(data).digest()
+        count += 1
+    result.append(count)
+
+def report((result, secs)):
+    if not result:
+        return True
+    mb = result[0] * 65536 / 1048576.0
+    print 'thread hashed %.1f MB in %.1f s (%.1f MB/s)' % (mb, secs, mb / secs)
+    return False
+
+def cmd_bench_threads(data, server, witem):
+    args = data.split()
+    secs = 5.0
+    if args:
+        secs = float(args[0])
+
+    result = []
+    thread = threading.Thread(target=worker, args=(secs, result))
+    thread.setDaemon(True)
+    thread.start()
+    if len(args) > 1:
+        irssi.command('exec -name bench_threads seq %d' % int(args[1]))
+    irssi.timeout_add(500, report, (result, secs))
+
+irssi.command_bind('bench_threads', cmd_bench_threads)
@@ -0,0 +1,86 @@
+"""
+    Compare timeout_add with Script.timer for many short timers.
+
+    /bench_timers [count]
+
+    Adds `count' timers a few seconds out and cancels them in a random 
+    order, first with timeout_add/source_remove and then with 
+    irssi.timer/Timer.cancel. Then adds `count' one shot timers within 
+    100ms, with and without a 50ms tolerance, and reports how long it 
+    takes for all of them to fire. Last, `count' one shot timeout_add 
+    sources fire with data only they hold, which is freed when GLib drops
+    each source after it returns False.
+"""
+
+import irssi
+import random
+import time
+
+def noop(*args):
+    return False
+
+def run_source(count):
+    script = irssi.get_script()
+    start = time.time()
+    tags = [script.timeout_add(5000 + i % 1000, noop) for i in xrange(count)]
+    added = time.time()
+    random.shuffle(tags)
+    for tag in tags:
+        script.source_remove(tag)
+    return added - start, time.time() - added
+
+def run_timer(count):
+    start = time.time()
+    timers = [irssi.timer(5000 + i % 1000, noop) for i in xrange(count)]
+    added = time.time()
+    random.shuffle(timers)
+    for timer in timers:
+        timer.cancel()
+    return added - start, time.time() - added
+
+class Burst:
+    def __init__(self, count, tolerance):
+        self.tolerance = tolerance
+        self.left = count
+        self.start = time.time()
+        for i in xrange(count):
+            irssi.timer(random.randint(1, 100), self.fired, tolerance=tolerance)
+
+    def fired(self):
+        self.left -= 1
+        if self.left == 0:
+            print 'burst with %dms tolerance done in %.1f ms' % (self.tolerance, 
+                    (time.time() - self.start) * 1000.0)
+
+class SourceBurst:
+    def __init__(self, count):
+        self.left = count
+        self.start = time.time()
+        script = irssi.get_script()
+        for i in xrange(count):
+            # nested containers go through the trashcan when freed
+            data = {'n': i, 'args': [(i, str(i))]}
+            script.timeout_add(random.randint(1, 100), self.fired, data)
+
+    def fired(self, data):
+        self.left -= 1
+        if self.left == 0:
+            print 'timeout_add burst with data done in %.1f ms' % (
+                    (time.time() - self.start) * 1000.0)
+        return False
+
+def cmd_bench_timers(data, server, witem):
+    count = 10000
+    if data:
+        count = int(data)
+
+    for name, run in [('timeout_add', run_source), ('timer', run_timer)]:
+        add, cancel = run(count)
+        print '%-12s add %8.2f usec cancel %8.2f usec' % (name, 
+                add * 1000000.0 / count, cancel * 1000000.0 / count)
+
+    Burst(count, 0)
+    Burst(count, 50)
+    SourceBurst(count)
+
+irssi.command_bind('bench_timers', cmd_bench_timers)
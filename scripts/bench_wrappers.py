@@ -0,0 +1,51 @@
+"""
+    Count wrapper allocations per dispatched signal.
+
+    /bench_wrappers [count]
+
+    Emits a script signal carrying the active server, channel and a nick
+    `count' times. The handler keeps every object it receives alive, so the
+    number of distinct objects seen is the number of wrappers allocated.
+"""
+
+import irssi
+import time
+
+seen = []
+
+def sig_bench(server, channel, nick):
+    seen.append(server)
+    seen.append(channel)
+    seen.append(nick)
+
+def cmd_bench_wrappers(data, server, witem):
+    global seen
+
+    count = 1000
+    if data:
+        count = int(data)
+
+    if not isinstance(witem, irssi.Channel):
+        print 'run this from a channel window'
+        return
+
+    nicks = witem.nicks()
+    if not nicks:
+        print 'channel has no nicks'
+        return
+
+    seen = []
+    nick = nicks[0]
+    start = time.time()
+    for i in xrange(count):
+        irssi.signal_emit('python bench wrappers', server, witem, nick)
+    elapsed = time.time() - start
+
+    allocs = len(set([id(obj) for obj in seen]))
+    print '%d dispatches, %d wrappers allocated (%.2f per dispatch), %.1f usec/dispatch' % \
+        (count, allocs, float(allocs) / count, elapsed * 1000000.0 / count)
+    seen = []
+
+irssi.get_script().signal_register('python bench wrappers', 'SCn')
+irssi.signal_add('python bench wrappers', sig_bench)
+irssi.command_bind('bench_wrappers', cmd_bench_wrappers)
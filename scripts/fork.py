@@ -17,12 +17,11 @@ def sig_pidwait(pid, status):
 
     irssi.signal_remove('pidwait')
 
-def read_child(fd, condition, out):
-    data = os.read(fd, 512)
-    if not data:
-        return False
-    out.write(data) 
-    return True
+def read_child(lines, out):
+    if lines is None:
+        return
+    # the lines keep their '\n', and a last partial line has none
+    out.write(''.join(lines))
 
 def childfunc():
     """ do your stuff """
@@ -46,8 +45,8 @@ def cmd_forkoff(data, server, witem):
         irssi.signal_add('pidwait', sig_pidwait)
 
         #redirect child output
-        irssi.io_add_watch(rs, read_child, sys.stdout)
-        irssi.io_add_watch(re, read_child, sys.stderr)
+        irssi.io_add_reader(rs, read_child, sys.stdout, keep_delimiter=True)
+        irssi.io_add_reader(re, read_child, sys.stderr, keep_delimiter=True)
 
     else:
         #child
@@ -0,0 +1,35 @@
+"""
+    Word counts per nick, meant to run out of process with /py host.
+
+    /py host hoststats
+    /hoststats [count]
+
+    Counts the words each nick says in channels, and prints the top
+    `count' nicks for the channel the command is run in.
+"""
+
+import irssi
+
+counts = {}
+
+def sig_message_public(server, msg, nick, address, target):
+    key = (server.tag, target.lower())
+    nicks = counts.setdefault(key, {})
+    nicks[nick] = nicks.get(nick, 0) + len(msg.split())
+
+def cmd_hoststats(data, server, witem):
+    if not witem or not server:
+        irssi.prnt('not in a channel')
+        return
+
+    top = 10
+    if data:
+        top = int(data)
+
+    nicks = counts.get((server.tag, witem.name.lower()), {}).items()
+    nicks.sort(lambda a, b: cmp(b[1], a[1]))
+    for nick, words in nicks[:top]:
+        witem.prnt('%-15s %8d' % (nick, words))
+
+irssi.signal_add('message public', sig_message_public)
+irssi.command_bind('hoststats', cmd_hoststats)
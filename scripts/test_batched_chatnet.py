@@ -0,0 +1,50 @@
+"""
+    Regression test: batching a chatnet signal must not break the shared
+    Chatnet wrapper.
+
+    /test_batched_chatnet
+
+    Queues 'chatnet created' in a batch, checks the wrapper found with
+    chatnet_find is still valid, then removes the network before the
+    batch is flushed. The batched wrapper must then be invalid, and
+    nothing may crash when the wrappers are freed.
+"""
+
+import irssi
+
+NAME = 'pybatchtest'
+
+def report(ok, what):
+    if ok:
+        print 'PASS', what
+    else:
+        print 'FAIL', what
+
+def on_batch(batch):
+    irssi.signal_remove('chatnet created', on_batch)
+    chatnets = [args[0] for args in batch if args[0] is not None]
+    report(len(chatnets) == 1, 'one chatnet queued')
+    report(not [c for c in chatnets if c.valid], 
+            'queued chatnet invalid after removal')
+    del batch, chatnets
+    # the cache and cleanup registry must not hold freed wrappers now
+    irssi.command('network add ' + NAME)
+    chatnet = irssi.chatnet_find(NAME)
+    report(chatnet is not None and chatnet.name == NAME, 
+            'chatnet usable after the wrappers were freed')
+    irssi.command('network remove ' + NAME)
+
+def cmd_test_batched_chatnet(data, server, witem):
+    irssi.signal_add_batched('chatnet created', on_batch, size=100, msecs=0)
+    irssi.command('network add ' + NAME)
+
+    chatnet = irssi.chatnet_find(NAME)
+    report(chatnet is not None and chatnet.valid, 
+            'shared chatnet wrapper valid while queued')
+    if chatnet is not None:
+        report(chatnet.name == NAME, 'shared chatnet wrapper name')
+    del chatnet
+
+    irssi.command('network remove ' + NAME)
+
+irssi.command_bind('test_batched_chatnet', cmd_test_batched_chatnet)
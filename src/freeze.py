@@ -0,0 +1,60 @@
+"""
+    Compile Python modules into a C file of frozen modules.
+
+    python freeze.py module.py ... > pyfrozen.c
+
+    Writes the marshalled code of each module as a byte array and a
+    pyfrozen_modules table for PyImport_FrozenModules. The code is only
+    good for the Python that ran this script, so its magic number is
+    written too and checked before the table is used.
+"""
+
+import sys
+import os
+import imp
+import marshal
+
+def c_bytes(data):
+    lines = []
+    for i in range(0, len(data), 12):
+        chunk = data[i:i + 12]
+        lines.append('    ' + ' '.join(['%d,' % ord(c) for c in chunk]))
+    return '\n'.join(lines)
+
+def main(paths):
+    out = sys.stdout
+    names = []
+
+    print >>out, '/* generated by freeze.py, do not edit */'
+    print >>out
+    print >>out, '#include <Python.h>'
+    print >>out, '#include "pyfrozen.h"'
+    print >>out
+
+    for path in paths:
+        name = os.path.splitext(os.path.basename(path))[0]
+        source = open(path, 'rU').read()
+        if not source.endswith('\n'):
+            source += '\n'
+
+        code = compile(source, os.path.basename(path), 'exec')
+        data = marshal.dumps(code)
+
+        print >>out, 'static unsigned char M_%s[] = {' % name
+        print >>out, c_bytes(data)
+        print >>out, '};'
+        print >>out
+        names.append(name)
+
+    magic = imp.get_magic()
+    magic = ord(magic[0]) | ord(magic[1]) << 8 | ord(magic[2]) << 16 | ord(magic[3]) << 24
+    print >>out, 'const long pyfrozen_magic = %dL;' % magic
+    print >>out
+    print >>out, 'struct _frozen pyfrozen_modules[] = {'
+    for name in names:
+        print >>out, '    {"%s", M_%s, (int)sizeof(M_%s)},' % (name, name, name)
+    print >>out, '    {0, 0, 0}'
+    print >>out, '};'
+
+if __name__ == '__main__':
+    main(sys.argv[1:])
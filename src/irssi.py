@@ -17,6 +17,10 @@ def signal_add(*args, **kwargs):
     """ see Script.signal_add() """
     get_script().signal_add(*args, **kwargs)
 
+def signal_add_batched(*args, **kwargs):
+    """ see Script.signal_add_batched() """
+    get_script().signal_add_batched(*args, **kwargs)
+
 def signal_remove(*args, **kwargs):
     """ see Script.signal_remove() """
     get_script().signal_remove(*args, **kwargs)
@@ -25,10 +29,49 @@ def timeout_add(*args, **kwargs):
     """ see Script.timeout_add() """
     get_script().timeout_add(*args, **kwargs)
 
+def timer(*args, **kwargs):
+    """ see Script.timer() """
+    return get_script().timer(*args, **kwargs)
+
 def io_add_watch(*args, **kwargs):
     """ see Script.io_add_watch() """
     get_script().io_add_watch(*args, **kwargs)
 
+def create_task(coro):
+    """ Run the generator coro in the script's event loop, see irssi_loop """
+    import irssi_loop
+    return irssi_loop.get_event_loop().create_task(coro)
+
+def get_event_loop():
+    """ see irssi_loop.get_event_loop() """
+    import irssi_loop
+    return irssi_loop.get_event_loop()
+
+def run_in_executor(func, *args, **kwargs):
+    """ Call func(*args) in the shared thread pool and return a Future 
+        for the result. If callback is given, callback(result) is called
+        from the main loop when func returns. See irssi_loop. 
+    """
+    import irssi_loop
+    callback = kwargs.pop('callback', None)
+    if kwargs:
+        raise TypeError('unexpected keyword arguments %r' % kwargs.keys())
+    future = irssi_loop.get_event_loop().run_in_executor(None, func, *args)
+    if callback:
+        def done(future):
+            if not future.cancelled():
+                callback(future.result())
+        future.add_done_callback(done)
+    return future
+
+def signal_emit_threadsafe(signal, *args):
+    """ signal_emit() from any thread, see call_soon_threadsafe() """
+    call_soon_threadsafe(signal_emit, signal, *args)
+
+def io_add_reader(*args, **kwargs):
+    """ see Script.io_add_reader() """
+    return get_script().io_add_reader(*args, **kwargs)
+
 def statusbar_item_register(*args, **kwargs):
     """ see Script.statusbar_item_register() """
     get_script().statusbar_item_register(*args, **kwargs)
@@ -0,0 +1,203 @@
+"""
+    Runs a script in a helper process started by /py host, see pyhost.c.
+
+    The script imports irssi as usual but gets a stand-in module with a
+    small part of the API: command_bind, command_unbind, signal_add,
+    signal_remove, command, prnt, timeout_add, source_remove and the
+    constants. Handlers get Snapshots instead of live objects: copies of
+    the objects' attributes made when the event was sent. Snapshots of
+    servers and window items have command() and prnt() methods that act
+    on the real objects in irssi, found by server tag and item name.
+"""
+
+import sys
+import time
+import heapq
+import traceback
+import _irssi
+
+MSGLEVEL_CLIENTCRAP = _irssi.MSGLEVEL_CLIENTCRAP
+MSGLEVEL_CLIENTNOTICE = _irssi.MSGLEVEL_CLIENTNOTICE
+MSGLEVEL_CLIENTERROR = _irssi.MSGLEVEL_CLIENTERROR
+
+class Snapshot(object):
+    """ attributes of an irssi object when the event was sent """
+
+    def __init__(self, attrs):
+        self.__dict__.update(attrs)
+
+    def __repr__(self):
+        return '<%s snapshot>' % self.__dict__.get('_type')
+
+    def _target(self):
+        # (server tag, item name) of the object in irssi
+        server = self.__dict__.get('server')
+        if isinstance(server, Snapshot):
+            return getattr(server, 'tag', None), getattr(self, 'name', None)
+        return getattr(self, 'tag', None), None
+
+    def command(self, cmd):
+        tag, name = self._target()
+        _irssi._host_send(('command', cmd, tag, name))
+
+    def prnt(self, text, msglvl=MSGLEVEL_CLIENTNOTICE):
+        tag, name = self._target()
+        _irssi._host_send(('prnt', text, msglvl, tag, name))
+
+def _wrap(value):
+    if isinstance(value, dict) and '_type' in value:
+        attrs = {}
+        for key, item in value.iteritems():
+            attrs[key] = _wrap(item)
+        return Snapshot(attrs)
+    if isinstance(value, list):
+        return [_wrap(item) for item in value]
+    return value
+
+class Output:
+    """ sys.stdout and sys.stderr, printed by irssi """
+
+    def __init__(self, level):
+        self.level = level
+        self.buf = []
+
+    def write(self, text):
+        if not text:
+            return
+        self.buf.append(text)
+        if '\n' == text[-1]:
+            text = ''.join(self.buf)[:-1]
+            for line in text.split('\n'):
+                _irssi._host_send(('prnt', line, self.level, None, None))
+            self.buf = []
+
+    def flush(self):
+        pass
+
+class Host:
+    def __init__(self):
+        self.handlers = {} # (kind, name) -> list of funcs
+        self.timers = [] # heap of (due, tag)
+        self.timer_funcs = {} # tag -> (msecs, func, data)
+        self.next_tag = 1
+
+    def bind(self, kind, name, func):
+        funcs = self.handlers.setdefault((kind, name), [])
+        if not funcs:
+            _irssi._host_send((kind == 'command' and 'command_bind' or 'signal_add', name))
+        funcs.append(func)
+
+    def unbind(self, kind, name, func):
+        funcs = self.handlers.get((kind, name), [])
+        if func is None:
+            del funcs[:]
+        elif func in funcs:
+            funcs.remove(func)
+        if not funcs and (kind, name) in self.handlers:
+            del self.handlers[(kind, name)]
+            _irssi._host_send((kind == 'command' and 'command_unbind' or 'signal_remove', name))
+
+    def timeout_add(self, msecs, func, data=None):
+        tag = self.next_tag
+        self.next_tag += 1
+        self.timer_funcs[tag] = (msecs, func, data)
+        heapq.heappush(self.timers, (time.time() + msecs / 1000.0, tag))
+        return tag
+
+    def source_remove(self, tag):
+        return self.timer_funcs.pop(tag, None) is not None
+
+    def timeout(self):
+        while self.timers and self.timers[0][1] not in self.timer_funcs:
+            heapq.heappop(self.timers)
+        if not self.timers:
+            return -1
+        return max(self.timers[0][0] - time.time(), 0)
+
+    def run_timers(self):
+        now = time.time()
+        while self.timers and self.timers[0][0] <= now:
+            due, tag = heapq.heappop(self.timers)
+            if tag not in self.timer_funcs:
+                continue
+            msecs, func, data = self.timer_funcs[tag]
+            try:
+                if data is None:
+                    ret = func()
+                else:
+                    ret = func(data)
+            except Exception:
+                traceback.print_exc()
+                ret = False
+            # like timeout_add in irssi, until func returns False
+            if ret and tag in self.timer_funcs:
+                heapq.heappush(self.timers, (now + msecs / 1000.0, tag))
+            else:
+                self.timer_funcs.pop(tag, None)
+
+    def dispatch(self, event):
+        kind, name, args = event
+        for func in list(self.handlers.get((kind, name), [])):
+            try:
+                func(*_wrap(args))
+            except Exception:
+                traceback.print_exc()
+
+def _module(host):
+    """ the irssi module seen by the script """
+    import types
+    irssi = types.ModuleType('irssi')
+
+    for key in dir(_irssi):
+        if key.isupper():
+            setattr(irssi, key, getattr(_irssi, key))
+
+    def command_bind(cmd, func):
+        host.bind('command', cmd, func)
+    def command_unbind(cmd, func=None):
+        host.unbind('command', cmd, func)
+    def signal_add(signal, func):
+        host.bind('signal', signal, func)
+    def signal_remove(signal, func=None):
+        host.unbind('signal', signal, func)
+    def command(cmd):
+        _irssi._host_send(('command', cmd, None, None))
+    def prnt(text, msglvl=MSGLEVEL_CLIENTNOTICE):
+        _irssi._host_send(('prnt', text, msglvl, None, None))
+
+    for func in (command_bind, command_unbind, signal_add, signal_remove,
+            command, prnt):
+        setattr(irssi, func.__name__, func)
+    irssi.timeout_add = host.timeout_add
+    irssi.source_remove = host.source_remove
+    irssi.Snapshot = Snapshot
+
+    return irssi
+
+def run(name, path, argv):
+    """ Load the script and handle events until irssi goes away. """
+    import types
+
+    sys.stdout = Output(MSGLEVEL_CLIENTCRAP)
+    sys.stderr = Output(MSGLEVEL_CLIENTERROR)
+
+    host = Host()
+    sys.modules['irssi'] = _module(host)
+    sys.argv = [path] + argv
+
+    module = types.ModuleType(name)
+    module.__file__ = path
+    sys.modules[name] = module
+    try:
+        execfile(path, module.__dict__)
+    except Exception:
+        traceback.print_exc()
+        return
+
+    while True:
+        events = _irssi._host_wait(host.timeout())
+        if events is None:
+            return
+        for event in events:
+            host.dispatch(event)
+        host.run_timers()
@@ -0,0 +1,610 @@
+"""
+    Event loop for coroutines, run by irssi's own main loop.
+
+    This follows the asyncio interface where Python 2 allows. A coroutine
+    is a generator that yields Futures (or None to let others run) and
+    gets the result back from the yield. Generators can't return a value
+    in Python 2, raise Return(value) instead. Needs Python 2.5.
+
+        def fetch(host):
+            yield irssi_loop.sleep(1.5)
+            data = yield read_reply(host)
+            raise irssi_loop.Return(data)
+
+        def main():
+            reply = yield irssi.create_task(fetch('localhost'))
+            print reply
+
+        irssi.create_task(main())
+
+    Each script has its own loop, see get_event_loop(). Timers and
+    watches belong to the script and its tasks are cancelled when it is
+    unloaded.
+
+    Blocking calls can run in a pool of threads shared by all scripts
+    with run_in_executor(). The pool has python_executor_threads threads.
+"""
+
+import sys
+import time
+import threading
+import traceback
+import _irssi
+
+PENDING = 'PENDING'
+CANCELLED = 'CANCELLED'
+FINISHED = 'FINISHED'
+
+WATCH_IN = _irssi.IO_IN | _irssi.IO_PRI | _irssi.IO_HUP | _irssi.IO_ERR
+WATCH_OUT = _irssi.IO_OUT | _irssi.IO_HUP | _irssi.IO_ERR
+
+class CancelledError(Exception):
+    """ the Future or Task was cancelled """
+
+class InvalidStateError(Exception):
+    """ the Future is not in a state for the operation """
+
+class Return(StopIteration):
+    """ raise Return(value) to return value from a coroutine """
+    def __init__(self, value=None):
+        StopIteration.__init__(self, value)
+        self.value = value
+
+def _fileno(fd):
+    if not isinstance(fd, (int, long)):
+        fd = fd.fileno()
+    return fd
+
+class Handle(object):
+    """ callback scheduled with call_soon() """
+
+    def __init__(self, loop, callback, args):
+        self._loop = loop
+        self._callback = callback
+        self._args = args
+        self._cancelled = False
+
+    def cancel(self):
+        self._cancelled = True
+
+    def cancelled(self):
+        return self._cancelled
+
+    def _run(self):
+        if self._cancelled or self._loop._closed:
+            return
+        try:
+            self._callback(*self._args)
+        except Exception:
+            traceback.print_exc()
+
+class TimerHandle(Handle):
+    """ callback scheduled with call_later() or call_at() """
+
+    def __init__(self, loop, when, callback, args):
+        Handle.__init__(self, loop, callback, args)
+        self._when = when
+        self._timer = None
+
+    def when(self):
+        return self._when
+
+    def cancel(self):
+        Handle.cancel(self)
+        if self._timer:
+            self._timer.cancel()
+            self._timer = None
+
+    def _run(self):
+        self._timer = None
+        Handle._run(self)
+
+class EventLoop(object):
+    """ event loop of a Script, see get_event_loop() """
+
+    def __init__(self, script):
+        self._script = script
+        self._ready = []
+        self._ready_timer = None
+        self._readers = {}
+        self._writers = {}
+        self._tasks = set()
+        self._current = None
+        self._jobs = set()
+        self._closed = False
+
+    def time(self):
+        return time.time()
+
+    def is_closed(self):
+        return self._closed
+
+    def is_running(self):
+        return not self._closed
+
+    def _check_closed(self):
+        if self._closed:
+            raise RuntimeError('Event loop is closed')
+
+    def call_soon(self, callback, *args):
+        """ Call callback(*args) on the next main loop iteration. Callbacks
+            run in the order they were added.
+        """
+        self._check_closed()
+        handle = Handle(self, callback, args)
+        self._ready.append(handle)
+        if not self._ready_timer:
+            self._ready_timer = self._script.timer(0, self._run_ready)
+        return handle
+
+    def _run_ready(self):
+        # callbacks added meanwhile wait for the next round
+        self._ready_timer = None
+        ready = self._ready
+        self._ready = []
+        for handle in ready:
+            handle._run()
+
+    def call_soon_threadsafe(self, callback, *args):
+        """ call_soon() from any thread. """
+        handle = Handle(self, callback, args)
+        _irssi.call_soon_threadsafe(handle._run)
+        return handle
+
+    def call_later(self, delay, callback, *args):
+        """ Call callback(*args) after delay seconds. """
+        return self.call_at(self.time() + delay, callback, *args)
+
+    def call_at(self, when, callback, *args):
+        """ Call callback(*args) at time when, see time(). """
+        self._check_closed()
+        handle = TimerHandle(self, when, callback, args)
+        msecs = int((when - self.time()) * 1000.0 + 0.5)
+        handle._timer = self._script.timer(max(msecs, 0), handle._run)
+        return handle
+
+    def _add_watch(self, watches, fd, condition, callback, args):
+        self._check_closed()
+        fd = _fileno(fd)
+        self._remove_watch(watches, fd)
+        handle = Handle(self, callback, args)
+        def ready(source, cond):
+            handle._run()
+            return True
+        watches[fd] = self._script.io_add_watch(fd, ready, condition=condition)
+        return handle
+
+    def _remove_watch(self, watches, fd):
+        tag = watches.pop(_fileno(fd), None)
+        if tag is None:
+            return False
+        self._script.source_remove(tag)
+        return True
+
+    def add_reader(self, fd, callback, *args):
+        """ Call callback(*args) whenever fd is readable. """
+        return self._add_watch(self._readers, fd, WATCH_IN, callback, args)
+
+    def remove_reader(self, fd):
+        return self._remove_watch(self._readers, fd)
+
+    def add_writer(self, fd, callback, *args):
+        """ Call callback(*args) whenever fd is writable. """
+        return self._add_watch(self._writers, fd, WATCH_OUT, callback, args)
+
+    def remove_writer(self, fd):
+        return self._remove_watch(self._writers, fd)
+
+    def create_future(self):
+        return Future(self)
+
+    def create_task(self, coro):
+        """ Run the generator coro as a Task. """
+        self._check_closed()
+        if not hasattr(coro, 'send'):
+            raise TypeError('a generator is required, got %r' % (coro,))
+        return Task(coro, self)
+
+    def run_in_executor(self, executor, func, *args):
+        """ Call func(*args) in a thread of executor, or of the shared 
+            pool if executor is None. Return a Future for the result, 
+            which is set from the main loop. Cancelling the Future before 
+            the call starts drops the call.
+        """
+        self._check_closed()
+        if executor is None:
+            executor = _get_executor()
+        future = executor._submit(self, func, args)
+        self._jobs.add(future)
+        return future
+
+    def run_until_complete(self, future):
+        raise RuntimeError('irssi runs the loop, use create_task() instead')
+
+    def run_forever(self):
+        raise RuntimeError('irssi runs the loop, use create_task() instead')
+
+    def stop(self):
+        pass
+
+    def close(self):
+        """ Cancel the tasks and remove the watches. Called when the
+            script is unloaded.
+        """
+        if self._closed:
+            return
+
+        for future in list(self._jobs):
+            future.cancel()
+        self._jobs.clear()
+        for task in list(self._tasks):
+            task.cancel()
+        # let the cancelled tasks handle CancelledError, but don't wait
+        # on anything they start meanwhile
+        for i in xrange(10):
+            if not self._ready:
+                break
+            self._ready_timer.cancel()
+            self._run_ready()
+        for task in list(self._tasks):
+            if task is self._current:
+                # closed from the task itself, it is cancelled when 
+                # it yields
+                continue
+            try:
+                task._coro.close()
+            except Exception:
+                traceback.print_exc()
+            task._finish()
+
+        self._closed = True
+        for fd in self._readers.keys():
+            self.remove_reader(fd)
+        for fd in self._writers.keys():
+            self.remove_writer(fd)
+        if self._ready_timer:
+            self._ready_timer.cancel()
+            self._ready_timer = None
+        self._ready = []
+
+class Future(object):
+    """ result of an operation that has not finished yet """
+
+    def __init__(self, loop=None):
+        if loop is None:
+            loop = get_event_loop()
+        self._loop = loop
+        self._state = PENDING
+        self._result = None
+        self._exc_info = None
+        self._callbacks = []
+
+    def __repr__(self):
+        return '<%s %s>' % (self.__class__.__name__, self._state)
+
+    def cancel(self):
+        if self._state != PENDING:
+            return False
+        self._state = CANCELLED
+        self._schedule_callbacks()
+        return True
+
+    def cancelled(self):
+        return self._state == CANCELLED
+
+    def done(self):
+        return self._state != PENDING
+
+    def result(self):
+        if self._state == CANCELLED:
+            raise CancelledError()
+        if self._state != FINISHED:
+            raise InvalidStateError('result is not ready')
+        if self._exc_info:
+            raise self._exc_info[0], self._exc_info[1], self._exc_info[2]
+        return self._result
+
+    def exception(self):
+        if self._state == CANCELLED:
+            raise CancelledError()
+        if self._state != FINISHED:
+            raise InvalidStateError('exception is not set')
+        if self._exc_info:
+            return self._exc_info[1]
+        return None
+
+    def add_done_callback(self, fn):
+        """ Call fn(future) when the future is done. """
+        if self._state != PENDING:
+            self._loop.call_soon(fn, self)
+        else:
+            self._callbacks.append(fn)
+
+    def remove_done_callback(self, fn):
+        count = len(self._callbacks)
+        self._callbacks = [f for f in self._callbacks if f != fn]
+        return count - len(self._callbacks)
+
+    def set_result(self, result):
+        if self._state != PENDING:
+            raise InvalidStateError('%r is done' % self)
+        self._result = result
+        self._state = FINISHED
+        self._schedule_callbacks()
+
+    def set_exception(self, exception):
+        if self._state != PENDING:
+            raise InvalidStateError('%r is done' % self)
+        self._set_exc_info((exception.__class__, exception, None))
+
+    def _set_exc_info(self, exc_info):
+        self._exc_info = exc_info
+        self._state = FINISHED
+        self._schedule_callbacks()
+
+    def _schedule_callbacks(self):
+        callbacks = self._callbacks
+        self._callbacks = []
+        if self._loop._closed:
+            return
+        for fn in callbacks:
+            self._loop.call_soon(fn, self)
+
+class Task(Future):
+    """ coroutine run by the event loop """
+
+    def __init__(self, coro, loop=None):
+        Future.__init__(self, loop)
+        self._coro = coro
+        self._waiter = None
+        self._must_cancel = False
+        self._loop._tasks.add(self)
+        self._loop.call_soon(self._step)
+
+    def cancel(self):
+        """ Throw CancelledError into the coroutine when it next runs. """
+        if self.done():
+            return False
+        if self._waiter is not None and self._waiter.cancel():
+            return True
+        self._must_cancel = True
+        return True
+
+    def _finish(self):
+        self._loop._tasks.discard(self)
+        if not self.done():
+            Future.cancel(self)
+
+    def _step(self, value=None, exc=None):
+        if self.done():
+            return
+        if self._must_cancel:
+            exc = CancelledError()
+            self._must_cancel = False
+        self._waiter = None
+
+        prev = self._loop._current
+        self._loop._current = self
+        try:
+            try:
+                if exc is not None:
+                    result = self._coro.throw(exc.__class__, exc)
+                else:
+                    result = self._coro.send(value)
+            finally:
+                self._loop._current = prev
+        except Return, e:
+            self._loop._tasks.discard(self)
+            self.set_result(e.value)
+        except StopIteration:
+            self._loop._tasks.discard(self)
+            self.set_result(None)
+        except CancelledError:
+            self._finish()
+        except Exception:
+            self._loop._tasks.discard(self)
+            if not self._callbacks:
+                # nobody is waiting for it
+                traceback.print_exc()
+            self._set_exc_info(sys.exc_info())
+        else:
+            if isinstance(result, Future):
+                self._waiter = result
+                result.add_done_callback(self._wakeup)
+                if self._must_cancel and result.cancel():
+                    self._must_cancel = False
+            elif result is None:
+                self._loop.call_soon(self._step)
+            else:
+                self._loop.call_soon(self._step, None,
+                        RuntimeError('Task got bad yield: %r' % (result,)))
+
+    def _wakeup(self, future):
+        try:
+            value = future.result()
+        except Exception, e:
+            self._step(None, e)
+        else:
+            self._step(value)
+
+class ThreadPoolExecutor(object):
+    """ pool of up to max_workers threads, see run_in_executor() """
+
+    def __init__(self, max_workers=None):
+        self._max_workers = max_workers
+        self._max = 1
+        self._jobs = []
+        self._cond = threading.Condition()
+        self._threads = 0
+        self._idle = 0
+        self._shutdown = False
+
+    def _submit(self, loop, func, args):
+        # main thread only, as it reads the setting
+        max_workers = self._max_workers
+        if max_workers is None:
+            max_workers = _irssi.settings_get_int('python_executor_threads')
+        future = Future(loop)
+
+        self._cond.acquire()
+        try:
+            if self._shutdown:
+                raise RuntimeError('executor is shut down')
+            self._max = max(max_workers, 1)
+            self._jobs.append((future, func, args))
+            start = self._idle == 0 and self._threads < self._max
+            if start:
+                self._threads += 1
+            else:
+                self._cond.notify()
+        finally:
+            self._cond.release()
+
+        if start:
+            thread = threading.Thread(target=self._worker, 
+                    name='irssi executor')
+            thread.setDaemon(True)
+            thread.start()
+
+        return future
+
+    def _next_job(self):
+        # with _cond held, returns None when the thread should exit
+        while True:
+            while not self._jobs and not self._shutdown:
+                self._idle += 1
+                self._cond.wait()
+                self._idle -= 1
+            if self._shutdown or self._threads > self._max:
+                self._threads -= 1
+                return None
+            future, func, args = self._jobs.pop(0)
+            # the script may have been unloaded meanwhile
+            if not future.cancelled():
+                return future, func, args
+
+    def _worker(self):
+        self._cond.acquire()
+        job = self._next_job()
+        while job:
+            self._cond.release()
+            future, func, args = job
+            try:
+                result = func(*args)
+                exc_info = None
+            except:
+                result = None
+                exc_info = sys.exc_info()
+            _irssi.call_soon_threadsafe(_set_job_result, future, result, 
+                    exc_info)
+            job = exc_info = None
+
+            self._cond.acquire()
+            job = self._next_job()
+        self._cond.release()
+
+    def shutdown(self):
+        """ Drop the queued calls and stop the threads as they finish. """
+        self._cond.acquire()
+        try:
+            self._shutdown = True
+            self._jobs = []
+            self._cond.notifyAll()
+        finally:
+            self._cond.release()
+
+def _set_job_result(future, result, exc_info):
+    future._loop._jobs.discard(future)
+    if future.done():
+        return
+    if exc_info:
+        if not future._callbacks:
+            # nobody is waiting for it
+            traceback.print_exception(*exc_info)
+        future._set_exc_info(exc_info)
+    else:
+        future.set_result(result)
+
+_executor = None
+
+def _get_executor():
+    global _executor
+    if _executor is None:
+        _executor = ThreadPoolExecutor()
+    return _executor
+
+def get_event_loop():
+    """ Return the event loop of the running script. """
+    script = _irssi.get_script()
+    if script.loop is None:
+        script.loop = EventLoop(script)
+    return script.loop
+
+def ensure_future(obj, loop=None):
+    """ Return obj if it is a Future, or run it as a Task. """
+    if isinstance(obj, Future):
+        return obj
+    if loop is None:
+        loop = get_event_loop()
+    return loop.create_task(obj)
+
+def create_task(coro):
+    return get_event_loop().create_task(coro)
+
+def _set_result(future, result):
+    if not future.done():
+        future.set_result(result)
+
+def sleep(delay, result=None):
+    """ Return a Future done with result after delay seconds. """
+    loop = get_event_loop()
+    future = Future(loop)
+    handle = loop.call_later(delay, _set_result, future, result)
+    future.add_done_callback(lambda f: handle.cancel())
+    return future
+
+def gather(*aws):
+    """ Return a Future done with the list of results of aws. The first
+        exception is passed on, and cancelling it cancels all of aws.
+    """
+    loop = get_event_loop()
+    futures = [ensure_future(aw, loop) for aw in aws]
+    outer = Future(loop)
+    left = [len(futures)]
+
+    def done(future):
+        if outer.done():
+            return
+        if future.cancelled():
+            outer.cancel()
+            return
+        if future._exc_info:
+            outer._set_exc_info(future._exc_info)
+            return
+        left[0] -= 1
+        if left[0] == 0:
+            outer.set_result([f.result() for f in futures])
+
+    def outer_done(f):
+        if f.cancelled():
+            for future in futures:
+                future.cancel()
+
+    if not futures:
+        outer.set_result([])
+        return outer
+    for future in futures:
+        future.add_done_callback(done)
+    outer.add_done_callback(outer_done)
+    return outer
+
+def wait_readable(fd):
+    """ Return a Future done when fd is readable. """
+    loop = get_event_loop()
+    future = Future(loop)
+    def ready():
+        loop.remove_reader(fd)
+        _set_result(future, None)
+    loop.add_reader(fd, ready)
+    future.add_done_callback(lambda f: loop.remove_reader(fd))
+    return future
@@ -23,24 +23,19 @@
 #include "pymodule.h"
 #include "ban-object.h"
 #include "pycore.h"
+#include "factory.h"
 
 /* monitor "ban remove" signal */
-static void ban_cleanup(CHANNEL_REC *chan, BAN_REC *ban)
+static void ban_cleanup(PyBan *pyban)
 {
-    PyBan *pyban = signal_get_user_data();
-
-    if (ban == pyban->data)
-    {
-        pyban->data = NULL;
-        pyban->cleanup_installed = 0;
-        signal_remove_data("ban remove", ban_cleanup, pyban);
-    }
+    pyban->data = NULL;
+    pyban->cleanup_installed = 0;
 }
 
 static void PyBan_dealloc(PyBan *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("ban remove", ban_cleanup, self); 
+        py_cleanup_remove(CLEANUP_BAN, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -156,7 +151,7 @@ PyObject *pyban_new(void *ban)
 
     pyban->data = ban;
     pyban->cleanup_installed = 1;
-    signal_add_last_data("ban remove", ban_cleanup, pyban);
+    py_cleanup_add(CLEANUP_BAN, pyban->data, (PyObject *)pyban, (CleanupFunc)ban_cleanup);
 
     return (PyObject *)pyban;
 }
@@ -26,22 +26,16 @@
 #include "pycore.h"
 
 /* monitor "channel destroyed" signal */
-static void chan_cleanup(CHANNEL_REC *chan)
+static void chan_cleanup(PyChannel *pychan)
 {
-    PyChannel *pychan = signal_get_user_data();
-
-    if (chan == pychan->data)
-    {
-        pychan->data = NULL;
-        pychan->cleanup_installed = 0;
-        signal_remove_data("channel destroyed", chan_cleanup, pychan);
-    }
+    pychan->data = NULL;
+    pychan->cleanup_installed = 0;
 }
 
 static void PyChannel_dealloc(PyChannel *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("channel destroyed", chan_cleanup, self);
+        py_cleanup_remove(CLEANUP_CHANNEL, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -372,7 +366,7 @@ PyObject *pychannel_sub_new(void *chan, const char *name, PyTypeObject *type)
     if (pychan)
     {
         PyChannel *pych = (PyChannel *)pychan;
-        signal_add_last_data("channel destroyed", chan_cleanup, pych);
+        py_cleanup_add(CLEANUP_CHANNEL, pych->data, (PyObject *)pych, (CleanupFunc)chan_cleanup);
         pych->cleanup_installed = 1;
     }
 
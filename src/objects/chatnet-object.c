@@ -25,23 +25,18 @@
 #include "pyirssi.h"
 #include "pycore.h"
 #include "pyutils.h"
+#include "factory.h"
 
-static void chatnet_cleanup(CHATNET_REC *cn)
+static void chatnet_cleanup(PyChatnet *pycn)
 {
-    PyChatnet *pycn = signal_get_user_data();
-
-    if (cn == pycn->data)
-    {
-        pycn->data = NULL;
-        pycn->cleanup_installed = 0;
-        signal_remove_data("chatnet destroyed", chatnet_cleanup, pycn);
-    }
+    pycn->data = NULL;
+    pycn->cleanup_installed = 0;
 }
 
 static void PyChatnet_dealloc(PyChatnet *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("chatnet destroyed", chatnet_cleanup, self);
+        py_cleanup_remove(CLEANUP_CHATNET, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -177,7 +172,7 @@ PyObject *pychatnet_sub_new(void *cn, PyTypeObject *subclass)
 
     pycn->data = cn;
     pycn->base_name = name;
-    signal_add_last_data("chatnet destroyed", chatnet_cleanup, pycn);
+    py_cleanup_add(CLEANUP_CHATNET, pycn->data, (PyObject *)pycn, (CleanupFunc)chatnet_cleanup);
     pycn->cleanup_installed = 1;
 
     return (PyObject *)pycn;
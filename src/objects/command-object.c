@@ -23,26 +23,21 @@
 #include "pymodule.h"
 #include "command-object.h"
 #include "pycore.h"
+#include "factory.h"
 
 #define COMMAND(cmd) ((COMMAND_REC *)cmd)
 
 /* monitor "commandlist remove" signal */
-static void command_cleanup(COMMAND_REC *command)
+static void command_cleanup(PyCommand *pycommand)
 {
-    PyCommand *pycommand = signal_get_user_data();
-
-    if (command == pycommand->data)
-    {
-        pycommand->data = NULL;
-        pycommand->cleanup_installed = 0;
-        signal_remove_data("commandlist remove", command_cleanup, pycommand);
-    }
+    pycommand->data = NULL;
+    pycommand->cleanup_installed = 0;
 }
 
 static void PyCommand_dealloc(PyCommand *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("commandlist remove", command_cleanup, self); 
+        py_cleanup_remove(CLEANUP_COMMAND, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -146,7 +141,7 @@ PyObject *pycommand_new(void *command)
 
     pycommand->data = command;
     pycommand->cleanup_installed = 1;
-    signal_add_last_data("commandlist remove", command_cleanup, pycommand);
+    py_cleanup_add(CLEANUP_COMMAND, pycommand->data, (PyObject *)pycommand, (CleanupFunc)command_cleanup);
 
     return (PyObject *)pycommand;
 }
@@ -27,22 +27,16 @@
 
 
 /* monitor "dcc destroyed signal" */
-static void dcc_cleanup(DCC_REC *dcc)
+static void dcc_cleanup(PyDcc *pydcc)
 {
-    PyDcc *pydcc = signal_get_user_data();
-
-    if (dcc == pydcc->data)
-    {
-        pydcc->data = NULL;
-        pydcc->cleanup_installed = 0;
-        signal_remove_data("dcc destroyed", dcc_cleanup, pydcc);
-    }
+    pydcc->data = NULL;
+    pydcc->cleanup_installed = 0;
 }
 
 static void PyDcc_dealloc(PyDcc *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("dcc destroyed", dcc_cleanup, self);
+        py_cleanup_remove(CLEANUP_DCC, self->data, (PyObject *)self);
 
     Py_XDECREF(self->server);
     Py_XDECREF(self->chat);
@@ -342,7 +336,7 @@ PyObject *pydcc_sub_new(void *dcc, const char *name, PyTypeObject *subclass)
     pydcc->base_name = name;
 
     pydcc->cleanup_installed = 1;
-    signal_add_last_data("dcc destroyed", dcc_cleanup, pydcc);
+    py_cleanup_add(CLEANUP_DCC, pydcc->data, (PyObject *)pydcc, (CleanupFunc)dcc_cleanup);
     
     return (PyObject *)pydcc;
 }
@@ -20,7 +20,9 @@
 
 #include <Python.h>
 #include "pyirssi.h"
+#include "pycore.h"
 #include "factory.h"
+#include "pystats.h"
 
 /* Irssi object factory works for all items with at least a type member.
  *
@@ -38,6 +40,73 @@
 
 GHashTable *init_map = NULL;
 
+/* Cleanup registry.
+ *
+ * Wrappers for records that Irssi can destroy must drop their data pointer 
+ * when that happens. Instead of each wrapper adding its own handler to the
+ * destroy signal (which makes every emit walk one handler per live wrapper),
+ * a single handler is installed per signal here. Live wrappers are kept in
+ * a hash keyed by the address of the record they wrap, so adding, removing
+ * and invalidating wrappers does not depend on how many others are alive.
+ */
+typedef struct
+{
+    PyObject *obj;
+    CleanupFunc func;
+} PY_CLEANUP_REC;
+
+typedef struct
+{
+    const char *signal;
+    int argn; /* position of the record in the signal's arguments */
+    GHashTable *objs; /* record -> GSList of PY_CLEANUP_REC */
+} PY_CLEANUP_SIG_REC;
+
+/* Wrapper cache: record -> PY_CACHE_REC.
+ *
+ * Records passed through py_irssi_new() and py_irssi_chat_new() map to the
+ * same Python object for as long as that object is alive, so handlers see
+ * identical wrappers from one signal to the next. Only wrappers known to
+ * the cleanup registry are cached; the entry is dropped when the record is
+ * destroyed or the wrapper is deallocated. The entry also keeps the type 
+ * of the record it was made for, so if a record is freed without its 
+ * cleanup signal, a new record of another type at the same address 
+ * doesn't get the old wrapper.
+ */
+typedef struct
+{
+    PyObject *obj; /* borrowed reference */
+    int type;
+    int chat_type; /* 0xffff for records without one */
+} PY_CACHE_REC;
+
+static GHashTable *wrapper_cache = NULL;
+
+/* indexed by PY_CLEANUP_TYPE */
+static PY_CLEANUP_SIG_REC cleanup_sigs[] = {
+    {"ban remove", 1, NULL},
+    {"channel destroyed", 0, NULL},
+    {"chatnet destroyed", 0, NULL},
+    {"commandlist remove", 0, NULL},
+    {"dcc destroyed", 0, NULL},
+    {"ignore destroyed", 0, NULL},
+    {"log remove", 0, NULL},
+    {"mainwindow destroyed", 0, NULL},
+    {"netsplit remove", 0, NULL},
+    {"netsplit server remove", 1, NULL},
+    {"nicklist remove", 1, NULL},
+    {"notifylist remove", 0, NULL},
+    {"exec remove", 0, NULL},
+    {"query destroyed", 0, NULL},
+    {"server disconnected", 0, NULL},
+    {"statusbar item destroyed", 0, NULL},
+    {"theme destroyed", 0, NULL},
+    {"window destroyed", 0, NULL},
+};
+
+/* object init functions are timed for /py startup */
+#define INIT_OBJECT(func) pystats_startup_call(#func, func)
+
 static int init_objects(void);
 static void register_chat(CHAT_PROTOCOL_REC *rec);
 static void unregister_chat(CHAT_PROTOCOL_REC *rec);
@@ -45,107 +114,125 @@ static void insert_map(int type, int chat_type, InitFunc func);
 static int remove_chat(void *key, void *value, void *chat_typep);
 static void register_nonchat(void);
 static InitFunc find_map(int type, int chat_type);
+static void py_cleanup_proxy(void *p1, void *p2);
+static PyObject *cache_lookup(void *rec, int type, int chat_type);
+static PyObject *cache_insert(void *rec, int type, int chat_type, PyObject *obj);
+static void cache_remove(void *rec, PyObject *obj);
+static void cleanup_init(void);
+static void cleanup_deinit(void);
 
 static int init_objects(void)
 {
-    if (!pyscript_init())
+    if (!INIT_OBJECT(pyscript_init))
         return 0;
 
     /* order is somewhat important here */
-    if (!base_objects_init())
+    if (!INIT_OBJECT(base_objects_init))
         return 0;
 
-    if (!window_item_object_init())
+    if (!INIT_OBJECT(window_item_object_init))
         return 0;
 
-    if (!channel_object_init())
+    if (!INIT_OBJECT(channel_object_init))
         return 0;
 
-    if (!query_object_init())
+    if (!INIT_OBJECT(query_object_init))
         return 0;
     
-    if (!server_object_init())
+    if (!INIT_OBJECT(server_object_init))
         return 0;
 
-    if (!connect_object_init())
+    if (!INIT_OBJECT(connect_object_init))
         return 0;
 
-    if (!irc_server_object_init())
+    if (!INIT_OBJECT(irc_server_object_init))
         return 0;
 
-    if (!irc_connect_object_init())
+    if (!INIT_OBJECT(irc_connect_object_init))
         return 0;
    
-    if (!irc_channel_object_init())
+    if (!INIT_OBJECT(irc_channel_object_init))
         return 0;
 
-    if (!ban_object_init())
+    if (!INIT_OBJECT(ban_object_init))
         return 0;
 
-    if (!nick_object_init())
+    if (!INIT_OBJECT(nick_object_init))
         return 0;
 
-    if (!chatnet_object_init())
+    if (!INIT_OBJECT(chatnet_object_init))
         return 0;
 
-    if (!reconnect_object_init())
+    if (!INIT_OBJECT(reconnect_object_init))
         return 0;
 
-    if (!window_object_init())
+    if (!INIT_OBJECT(window_object_init))
         return 0;
 
-    if (!textdest_object_init())
+    if (!INIT_OBJECT(textdest_object_init))
         return 0;
 
-    if (!rawlog_object_init())
+    if (!INIT_OBJECT(rawlog_object_init))
         return 0;
 
-    if (!log_object_init())
+    if (!INIT_OBJECT(log_object_init))
         return 0;
 
-    if (!logitem_object_init())
+    if (!INIT_OBJECT(logitem_object_init))
         return 0;
 
-    if (!ignore_object_init())
+    if (!INIT_OBJECT(ignore_object_init))
         return 0;
 
-    if (!dcc_object_init())
+    if (!INIT_OBJECT(dcc_object_init))
         return 0;
 
-    if (!dcc_chat_object_init())
+    if (!INIT_OBJECT(dcc_chat_object_init))
         return 0;
     
-    if (!dcc_get_object_init())
+    if (!INIT_OBJECT(dcc_get_object_init))
         return 0;
 
-    if (!dcc_send_object_init())
+    if (!INIT_OBJECT(dcc_send_object_init))
         return 0;
     
-    if (!netsplit_object_init())
+    if (!INIT_OBJECT(netsplit_object_init))
         return 0;
 
-    if (!netsplit_server_object_init())
+    if (!INIT_OBJECT(netsplit_server_object_init))
         return 0;
 
-    if (!netsplit_channel_object_init())
+    if (!INIT_OBJECT(netsplit_channel_object_init))
         return 0;
 
-    if (!notifylist_object_init())
+    if (!INIT_OBJECT(notifylist_object_init))
         return 0;
 
-    if (!process_object_init())
+    if (!INIT_OBJECT(process_object_init))
         return 0;
 
-    if (!command_object_init())
+    if (!INIT_OBJECT(command_object_init))
         return 0;
 
-    if (!theme_object_init())
+    if (!INIT_OBJECT(theme_object_init))
         return 0;
 
-    if (!statusbar_item_object_init())
+    if (!INIT_OBJECT(statusbar_item_object_init))
         return 0;
     
-    if (!main_window_object_init())
+    if (!INIT_OBJECT(main_window_object_init))
+        return 0;
+
+    if (!INIT_OBJECT(lazylist_object_init))
+        return 0;
+
+    if (!INIT_OBJECT(signal_object_init))
+        return 0;
+
+    if (!INIT_OBJECT(ircmessage_object_init))
+        return 0;
+
+    if (!INIT_OBJECT(timer_object_init))
         return 0;
 
     return 1;
@@ -253,18 +340,66 @@ static void unregister_chat(CHAT_PROTOCOL_REC *rec)
             GINT_TO_POINTER(rec->id));
 }
 
+static PyObject *cache_lookup(void *rec, int type, int chat_type)
+{
+    PY_CACHE_REC *entry = g_hash_table_lookup(wrapper_cache, rec);
+
+    if (!entry)
+        return NULL;
+
+    /* stale entry for a record that went away unnoticed */
+    if (entry->type != type || entry->chat_type != chat_type)
+    {
+        g_hash_table_remove(wrapper_cache, rec);
+        return NULL;
+    }
+
+    Py_INCREF(entry->obj);
+    return entry->obj;
+}
+
+/* all objects made by the factory begin with PyIrssi_HEAD */
+static PyObject *cache_insert(void *rec, int type, int chat_type, PyObject *obj)
+{
+    PY_CACHE_REC *entry;
+
+    if (obj && ((PyIrssiBase *)obj)->cleanup_installed)
+    {
+        entry = g_new(PY_CACHE_REC, 1);
+        entry->obj = obj;
+        entry->type = type;
+        entry->chat_type = chat_type;
+        g_hash_table_insert(wrapper_cache, rec, entry);
+    }
+
+    return obj;
+}
+
+static void cache_remove(void *rec, PyObject *obj)
+{
+    PY_CACHE_REC *entry = g_hash_table_lookup(wrapper_cache, rec);
+
+    if (entry && entry->obj == obj)
+        g_hash_table_remove(wrapper_cache, rec);
+}
+
 PyObject *py_irssi_new(void *typeobj, int managed)
 {
     IRSSI_BASE_REC *base = typeobj;
     InitFunc ifunc;
+    PyObject *obj;
    
     if (!base)
         Py_RETURN_NONE;
+
+    obj = cache_lookup(typeobj, base->type, 0xffff);
+    if (obj)
+        return obj;
     
     ifunc = find_map(base->type, 0xffff);
 
     if (ifunc)
-        return ifunc(typeobj, managed);
+        return cache_insert(typeobj, base->type, 0xffff, ifunc(typeobj, managed));
 
     return PyErr_Format(PyExc_RuntimeError, "no initfunc for object type %d", base->type);
 }
@@ -273,14 +408,20 @@ PyObject *py_irssi_chat_new(void *typeobj, int managed)
 {
     IRSSI_CHAT_REC *chat = typeobj;
     InitFunc ifunc;
+    PyObject *obj;
         
     if (!chat)
         Py_RETURN_NONE;
+
+    obj = cache_lookup(typeobj, chat->type, chat->chat_type);
+    if (obj)
+        return obj;
     
     ifunc = find_map(chat->type, chat->chat_type);
 
     if (ifunc)
-        return ifunc(typeobj, managed);
+        return cache_insert(typeobj, chat->type, chat->chat_type, 
+                ifunc(typeobj, managed));
 
     return PyErr_Format(PyExc_RuntimeError, "no initfunc for object type %d, chat_type %d", 
             chat->type, chat->chat_type);
@@ -316,6 +457,131 @@ error:
     return NULL;
 }
 
+static void py_cleanup_proxy(void *p1, void *p2)
+{
+    PY_CLEANUP_SIG_REC *sig = signal_get_user_data();
+    void *rec = sig->argn == 0? p1 : p2;
+    GSList *list, *node;
+    int gil;
+
+    /* script threads may free wrappers meanwhile */
+    gil = python_gil_enter();
+    list = g_hash_table_lookup(sig->objs, rec);
+    if (!list)
+    {
+        python_gil_leave(gil);
+        return;
+    }
+
+    g_hash_table_remove(sig->objs, rec);
+
+    for (node = list; node != NULL; node = node->next)
+    {
+        PY_CLEANUP_REC *crec = node->data;
+
+        cache_remove(rec, crec->obj);
+        crec->func(crec->obj);
+        g_free(crec);
+    }
+
+    g_slist_free(list);
+    python_gil_leave(gil);
+}
+
+void py_cleanup_add(PY_CLEANUP_TYPE type, void *rec, PyObject *obj, CleanupFunc func)
+{
+    PY_CLEANUP_SIG_REC *sig;
+    PY_CLEANUP_REC *crec;
+    GSList *list;
+
+    g_return_if_fail(type >= 0 && type < CLEANUP_MAX);
+
+    sig = &cleanup_sigs[type];
+    g_return_if_fail(sig->objs != NULL);
+
+    crec = g_new0(PY_CLEANUP_REC, 1);
+    crec->obj = obj;
+    crec->func = func;
+
+    list = g_hash_table_lookup(sig->objs, rec);
+    list = g_slist_prepend(list, crec);
+    g_hash_table_insert(sig->objs, rec, list);
+}
+
+void py_cleanup_remove(PY_CLEANUP_TYPE type, void *rec, PyObject *obj)
+{
+    PY_CLEANUP_SIG_REC *sig;
+    GSList *list, *node;
+
+    g_return_if_fail(type >= 0 && type < CLEANUP_MAX);
+
+    sig = &cleanup_sigs[type];
+    if (!sig->objs)
+        return;
+
+    list = g_hash_table_lookup(sig->objs, rec);
+    for (node = list; node != NULL; node = node->next)
+    {
+        PY_CLEANUP_REC *crec = node->data;
+
+        if (crec->obj == obj)
+        {
+            cache_remove(rec, obj);
+            g_free(crec);
+            list = g_slist_delete_link(list, node);
+            break;
+        }
+    }
+
+    if (list)
+        g_hash_table_insert(sig->objs, rec, list);
+    else
+        g_hash_table_remove(sig->objs, rec);
+}
+
+static void cleanup_init(void)
+{
+    int i;
+
+    g_return_if_fail(G_N_ELEMENTS(cleanup_sigs) == CLEANUP_MAX);
+
+    wrapper_cache = g_hash_table_new_full(g_direct_hash, g_direct_equal, 
+            NULL, g_free);
+
+    for (i = 0; i < CLEANUP_MAX; i++)
+    {
+        cleanup_sigs[i].objs = g_hash_table_new(g_direct_hash, g_direct_equal);
+        signal_add_last_data(cleanup_sigs[i].signal, 
+                (SIGNAL_FUNC) py_cleanup_proxy, &cleanup_sigs[i]);
+    }
+}
+
+static int free_cleanup_list(void *key, GSList *list, void *data)
+{
+    g_slist_foreach(list, (GFunc)g_free, NULL);
+    g_slist_free(list);
+
+    return TRUE;
+}
+
+static void cleanup_deinit(void)
+{
+    int i;
+
+    for (i = 0; i < CLEANUP_MAX; i++)
+    {
+        signal_remove_data(cleanup_sigs[i].signal, 
+                (SIGNAL_FUNC) py_cleanup_proxy, &cleanup_sigs[i]);
+        g_hash_table_foreach_remove(cleanup_sigs[i].objs, 
+                (GHRFunc)free_cleanup_list, NULL);
+        g_hash_table_destroy(cleanup_sigs[i].objs);
+        cleanup_sigs[i].objs = NULL;
+    }
+
+    g_hash_table_destroy(wrapper_cache);
+    wrapper_cache = NULL;
+}
+
 int factory_init(void)
 {
     g_return_val_if_fail(init_map == NULL, 0);
@@ -323,6 +589,8 @@ int factory_init(void)
     if (!init_objects())
         return 0;
 
+    cleanup_init();
+
     init_map = g_hash_table_new(g_direct_hash, g_direct_equal);
  	g_slist_foreach(chat_protocols, (GFunc) register_chat, NULL);
     register_nonchat();
@@ -342,5 +610,7 @@ void factory_deinit(void)
 
 	signal_remove("chat protocol created", (SIGNAL_FUNC) register_chat);
 	signal_remove("chat protocol destroyed", (SIGNAL_FUNC) unregister_chat);
+
+    cleanup_deinit();
 }
 
@@ -35,6 +35,10 @@
 #include "theme-object.h"
 #include "statusbar-item-object.h"
 #include "main-window-object.h"
+#include "lazylist-object.h"
+#include "signal-object.h"
+#include "ircmessage-object.h"
+#include "timer-object.h"
 
 int factory_init(void);
 void factory_deinit(void);
@@ -45,6 +49,10 @@ void factory_deinit(void);
  *     and some are never managed (Reconnect)
  */
 
+/* Wrappers for records watched by the cleanup registry are cached, so the
+ * same record gives back the same object while that object is alive.
+ */
+
 /* For objects with a type member but no chat_type */
 PyObject *py_irssi_new(void *typeobj, int managed);
 /* For objects with both type and chat_type members */
@@ -55,4 +63,36 @@ PyObject *py_irssi_objlist_new(GSList *node, int managed, InitFunc init);
 #define py_irssi_chatlist_new(n, m) py_irssi_objlist_new(n, m, py_irssi_chat_new)
 #define py_irssi_list_new(n, m) py_irssi_objlist_new(n, m, py_irssi_new)
 
+/* Destroy signals watched by the cleanup registry. factory.c installs
+ * one handler for each; the order here must match cleanup_sigs there.
+ */
+typedef enum
+{
+    CLEANUP_BAN,
+    CLEANUP_CHANNEL,
+    CLEANUP_CHATNET,
+    CLEANUP_COMMAND,
+    CLEANUP_DCC,
+    CLEANUP_IGNORE,
+    CLEANUP_LOG,
+    CLEANUP_MAINWINDOW,
+    CLEANUP_NETSPLIT,
+    CLEANUP_NETSPLIT_SERVER,
+    CLEANUP_NICK,
+    CLEANUP_NOTIFYLIST,
+    CLEANUP_PROCESS,
+    CLEANUP_QUERY,
+    CLEANUP_SERVER,
+    CLEANUP_STATUSBAR_ITEM,
+    CLEANUP_THEME,
+    CLEANUP_WINDOW,
+    CLEANUP_MAX
+} PY_CLEANUP_TYPE;
+
+/* called with the wrapper when its record is destroyed; it should
+   clear the data pointer and cleanup_installed flag */
+typedef void (*CleanupFunc)(PyObject *);
+void py_cleanup_add(PY_CLEANUP_TYPE type, void *rec, PyObject *obj, CleanupFunc func);
+void py_cleanup_remove(PY_CLEANUP_TYPE type, void *rec, PyObject *obj);
+
 #endif
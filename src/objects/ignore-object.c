@@ -26,22 +26,16 @@
 #include "pycore.h"
 
 /* monitor "ignore destroy" signal */
-static void ignore_cleanup(IGNORE_REC *ignore)
+static void ignore_cleanup(PyIgnore *pyignore)
 {
-    PyIgnore *pyignore = signal_get_user_data();
-
-    if (ignore == pyignore->data)
-    {
-        pyignore->data = NULL;
-        pyignore->cleanup_installed = 0;
-        signal_remove_data("ignore destroy", ignore_cleanup, pyignore);
-    }
+    pyignore->data = NULL;
+    pyignore->cleanup_installed = 0;
 }
 
 static void PyIgnore_dealloc(PyIgnore *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("ignore destroy", ignore_cleanup, self);
+        py_cleanup_remove(CLEANUP_IGNORE, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -285,7 +279,7 @@ PyObject *pyignore_new(void *ignore)
 
     pyignore->data = ignore;
     pyignore->cleanup_installed = 1;
-    signal_add_last_data("ignore destroy", ignore_cleanup, pyignore);
+    py_cleanup_add(CLEANUP_IGNORE, pyignore->data, (PyObject *)pyignore, (CleanupFunc)ignore_cleanup);
 
     return (PyObject *)pyignore;
 }
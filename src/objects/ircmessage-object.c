@@ -0,0 +1,404 @@
+/* 
+    irssi-python
+
+    Copyright (C) 2006 Christopher Davis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <Python.h>
+#include "pyirssi.h"
+#include "pymodule.h"
+#include "ircmessage-object.h"
+
+static void PyIrcMessage_dealloc(PyIrcMessage *self)
+{
+    Py_XDECREF(self->line);
+    Py_XDECREF(self->params_obj);
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+static PyObject *PyIrcMessage_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyIrcMessage *self;
+
+    self = (PyIrcMessage *)type->tp_alloc(type, 0);
+    if (!self)
+        return NULL;
+
+    return (PyObject *)self;
+}
+
+static void span_set(PY_IRC_SPAN *span, int start, int end)
+{
+    span->start = start;
+    span->len = end - start;
+}
+
+/* [:nick[!user][@host] ]command [params] [:trailing] */
+static void ircmessage_parse(PyIrcMessage *self)
+{
+    const char *buf = PyString_AS_STRING(self->line);
+    int len = PyString_GET_SIZE(self->line);
+    int p = 0, start;
+
+    self->nick.len = self->user.len = self->host.len = -1;
+    self->trailing.len = -1;
+    self->command.start = self->command.len = 0;
+    self->nparams = 0;
+
+    if (buf[0] == ':')
+    {
+        int bang = -1, at = -1;
+
+        for (p = 1; p < len && buf[p] != ' '; p++)
+        {
+            if (buf[p] == '!' && bang < 0 && at < 0)
+                bang = p;
+            else if (buf[p] == '@' && at < 0)
+                at = p;
+        }
+
+        span_set(&self->nick, 1, bang >= 0? bang : (at >= 0? at : p));
+        if (bang >= 0)
+            span_set(&self->user, bang + 1, at >= 0? at : p);
+        if (at >= 0)
+            span_set(&self->host, at + 1, p);
+    }
+
+    while (p < len && buf[p] == ' ')
+        p++;
+
+    for (start = p; p < len && buf[p] != ' '; p++)
+        ;
+    span_set(&self->command, start, p);
+
+    while (self->nparams < IRC_MAX_PARAMS)
+    {
+        PY_IRC_SPAN *param = &self->params[self->nparams];
+
+        while (p < len && buf[p] == ' ')
+            p++;
+        if (p >= len)
+            break;
+
+        if (buf[p] == ':')
+        {
+            span_set(&self->trailing, p + 1, len);
+            *param = self->trailing;
+            self->nparams++;
+            break;
+        }
+
+        /* the last param takes the rest of the line */
+        if (self->nparams == IRC_MAX_PARAMS - 1)
+        {
+            span_set(param, p, len);
+            self->nparams++;
+            break;
+        }
+
+        for (start = p; p < len && buf[p] != ' '; p++)
+            ;
+        span_set(param, start, p);
+        self->nparams++;
+    }
+}
+
+PyDoc_STRVAR(PyIrcMessage_doc,
+    "__init__(line)\n"
+    "\n"
+    "Parse a raw IRC line, as from Rawlog.get_lines()\n"
+);
+static int PyIrcMessage_init(PyIrcMessage *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"line", NULL};
+    PyObject *line;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "S", kwlist, &line))
+        return -1;
+
+    Py_INCREF(line);
+    Py_XDECREF(self->line);
+    Py_CLEAR(self->params_obj);
+    self->line = line;
+    ircmessage_parse(self);
+
+    return 0;
+}
+
+static PyObject *span_get(PyIrcMessage *self, PY_IRC_SPAN *span)
+{
+    if (span->len < 0)
+        Py_RETURN_NONE;
+
+    return PyString_FromStringAndSize(PyString_AS_STRING(self->line) + span->start, 
+            span->len);
+}
+
+/* Getters */
+PyDoc_STRVAR(PyIrcMessage_line_doc,
+    "The whole line"
+);
+static PyObject *PyIrcMessage_line_get(PyIrcMessage *self, void *closure)
+{
+    RET_NULL_IF_INVALID(self->line);
+    RET_AS_OBJ_OR_NONE(self->line);
+}
+
+PyDoc_STRVAR(PyIrcMessage_nick_doc,
+    "Nick or server name from the prefix, or None"
+);
+static PyObject *PyIrcMessage_nick_get(PyIrcMessage *self, void *closure)
+{
+    RET_NULL_IF_INVALID(self->line);
+    return span_get(self, &self->nick);
+}
+
+PyDoc_STRVAR(PyIrcMessage_user_doc,
+    "User name from the prefix, or None"
+);
+static PyObject *PyIrcMessage_user_get(PyIrcMessage *self, void *closure)
+{
+    RET_NULL_IF_INVALID(self->line);
+    return span_get(self, &self->user);
+}
+
+PyDoc_STRVAR(PyIrcMessage_host_doc,
+    "Host from the prefix, or None"
+);
+static PyObject *PyIrcMessage_host_get(PyIrcMessage *self, void *closure)
+{
+    RET_NULL_IF_INVALID(self->line);
+    return span_get(self, &self->host);
+}
+
+PyDoc_STRVAR(PyIrcMessage_command_doc,
+    "Command or numeric, as sent"
+);
+static PyObject *PyIrcMessage_command_get(PyIrcMessage *self, void *closure)
+{
+    RET_NULL_IF_INVALID(self->line);
+    return span_get(self, &self->command);
+}
+
+PyDoc_STRVAR(PyIrcMessage_params_doc,
+    "Tuple of params, including the trailing one"
+);
+static PyObject *PyIrcMessage_params_get(PyIrcMessage *self, void *closure)
+{
+    int i;
+
+    RET_NULL_IF_INVALID(self->line);
+
+    if (!self->params_obj)
+    {
+        PyObject *params = PyTuple_New(self->nparams);
+        if (!params)
+            return NULL;
+
+        for (i = 0; i < self->nparams; i++)
+        {
+            PyObject *param = span_get(self, &self->params[i]);
+            if (!param)
+            {
+                Py_DECREF(params);
+                return NULL;
+            }
+
+            PyTuple_SET_ITEM(params, i, param);
+        }
+
+        self->params_obj = params;
+    }
+
+    RET_AS_OBJ_OR_NONE(self->params_obj);
+}
+
+PyDoc_STRVAR(PyIrcMessage_trailing_doc,
+    "Text after the last ' :', or None"
+);
+static PyObject *PyIrcMessage_trailing_get(PyIrcMessage *self, void *closure)
+{
+    RET_NULL_IF_INVALID(self->line);
+    return span_get(self, &self->trailing);
+}
+
+/* specialized getters/setters */
+static PyGetSetDef PyIrcMessage_getseters[] = {
+    {"line", (getter)PyIrcMessage_line_get, NULL,
+        PyIrcMessage_line_doc, NULL},
+    {"nick", (getter)PyIrcMessage_nick_get, NULL,
+        PyIrcMessage_nick_doc, NULL},
+    {"user", (getter)PyIrcMessage_user_get, NULL,
+        PyIrcMessage_user_doc, NULL},
+    {"host", (getter)PyIrcMessage_host_get, NULL,
+        PyIrcMessage_host_doc, NULL},
+    {"command", (getter)PyIrcMessage_command_get, NULL,
+        PyIrcMessage_command_doc, NULL},
+    {"params", (getter)PyIrcMessage_params_get, NULL,
+        PyIrcMessage_params_doc, NULL},
+    {"trailing", (getter)PyIrcMessage_trailing_get, NULL,
+        PyIrcMessage_trailing_doc, NULL},
+    {NULL}
+};
+
+/* Methods */
+PyDoc_STRVAR(PyIrcMessage_param_doc,
+    "param(i, default=None) -> str\n"
+    "\n"
+    "Return param i without building the params tuple\n"
+);
+static PyObject *PyIrcMessage_param(PyIrcMessage *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"i", "default", NULL};
+    int i;
+    PyObject *def = Py_None;
+
+    RET_NULL_IF_INVALID(self->line);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|O", kwlist, 
+           &i, &def))
+        return NULL;
+
+    if (i < 0)
+        i += self->nparams;
+
+    if (i < 0 || i >= self->nparams)
+        RET_AS_OBJ_OR_NONE(def);
+
+    return span_get(self, &self->params[i]);
+}
+
+static PyObject *PyIrcMessage_str(PyIrcMessage *self)
+{
+    RET_NULL_IF_INVALID(self->line);
+    RET_AS_OBJ_OR_NONE(self->line);
+}
+
+/* Methods for object */
+static PyMethodDef PyIrcMessage_methods[] = {
+    {"param", (PyCFunction)PyIrcMessage_param, METH_VARARGS | METH_KEYWORDS,
+        PyIrcMessage_param_doc},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject PyIrcMessageType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "irssi.IrcMessage",            /*tp_name*/
+    sizeof(PyIrcMessage),             /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)PyIrcMessage_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    (reprfunc)PyIrcMessage_str, /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /*tp_flags*/
+    PyIrcMessage_doc,           /* tp_doc */
+    0,		               /* tp_traverse */
+    0,		               /* tp_clear */
+    0,		               /* tp_richcompare */
+    0,		               /* tp_weaklistoffset */
+    0,		               /* tp_iter */
+    0,		               /* tp_iternext */
+    PyIrcMessage_methods,             /* tp_methods */
+    0,                      /* tp_members */
+    PyIrcMessage_getseters,        /* tp_getset */
+    0,          /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    (initproc)PyIrcMessage_init,      /* tp_init */
+    0,                         /* tp_alloc */
+    PyIrcMessage_new,                 /* tp_new */
+};
+
+/* IrcMessage factory function. Signals give the prefix as nick and 
+   address, and "event <cmd>" signals leave the command out of data. */
+PyObject *pyircmessage_new(const char *data, const char *command, 
+        const char *nick, const char *address)
+{
+    PyIrcMessage *pymsg;
+    GString *line;
+
+    g_return_val_if_fail(data != NULL, NULL);
+
+    pymsg = py_inst(PyIrcMessage, PyIrcMessageType);
+    if (!pymsg)
+        return NULL;
+
+    line = g_string_new(NULL);
+    if (nick && *nick)
+    {
+        g_string_append_c(line, ':');
+        g_string_append(line, nick);
+        if (address && *address)
+        {
+            /* address is user@host */
+            if (strchr(address, '@'))
+                g_string_append_c(line, '!');
+            else
+                g_string_append_c(line, '@');
+            g_string_append(line, address);
+        }
+        g_string_append_c(line, ' ');
+    }
+
+    if (command)
+    {
+        g_string_append(line, command);
+        g_string_append_c(line, ' ');
+    }
+
+    g_string_append(line, data);
+
+    pymsg->line = PyString_FromStringAndSize(line->str, line->len);
+    g_string_free(line, TRUE);
+
+    if (!pymsg->line)
+    {
+        Py_DECREF(pymsg);
+        return NULL;
+    }
+
+    ircmessage_parse(pymsg);
+
+    return (PyObject *)pymsg;
+}
+
+int ircmessage_object_init(void) 
+{
+    g_return_val_if_fail(py_module != NULL, 0);
+
+    if (PyType_Ready(&PyIrcMessageType) < 0)
+        return 0;
+    
+    Py_INCREF(&PyIrcMessageType);
+    PyModule_AddObject(py_module, "IrcMessage", (PyObject *)&PyIrcMessageType);
+
+    return 1;
+}
@@ -0,0 +1,40 @@
+#ifndef _IRCMESSAGE_OBJECT_H_
+#define _IRCMESSAGE_OBJECT_H_
+
+#include <Python.h>
+#include "base-objects.h"
+
+#define IRC_MAX_PARAMS 15
+
+/* part of the line, len is -1 when the part is missing */
+typedef struct
+{
+    int start;
+    int len;
+} PY_IRC_SPAN;
+
+/* A parsed IRC line. Only the line is stored as a string; the parts are
+ * offsets into it and become strings when asked for.
+ */
+typedef struct
+{
+    PyObject_HEAD
+    PyObject *line;
+    PyObject *params_obj; /* tuple, made on first access */
+    PY_IRC_SPAN nick;
+    PY_IRC_SPAN user;
+    PY_IRC_SPAN host;
+    PY_IRC_SPAN command;
+    PY_IRC_SPAN trailing;
+    PY_IRC_SPAN params[IRC_MAX_PARAMS];
+    int nparams;
+} PyIrcMessage;
+
+extern PyTypeObject PyIrcMessageType;
+
+int ircmessage_object_init(void);
+PyObject *pyircmessage_new(const char *data, const char *command, 
+        const char *nick, const char *address);
+#define pyircmessage_check(op) PyObject_TypeCheck(op, &PyIrcMessageType)
+
+#endif
@@ -0,0 +1,224 @@
+/* 
+    irssi-python
+
+    Copyright (C) 2006 Christopher Davis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <Python.h>
+#include "pyirssi.h"
+#include "pymodule.h"
+#include "lazylist-object.h"
+
+#if PY_VERSION_HEX < 0x02050000
+typedef int Py_ssize_t;
+#define lenfunc inquiry
+#define ssizeargfunc intargfunc
+#define ssizessizeargfunc intintargfunc
+#endif
+
+static void PyLazyList_dealloc(PyLazyList *self)
+{
+    int i;
+
+    for (i = 0; i < self->len; i++)
+        Py_XDECREF(self->items[i]);
+
+    g_free(self->items);
+    g_free(self->recs);
+
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+/* returns new reference */
+static PyObject *lazylist_get(PyLazyList *self, int i)
+{
+    if (!self->items[i])
+    {
+        RET_NULL_IF_INVALID(self->recs);
+
+        self->items[i] = self->init(self->recs[i], self->managed);
+        if (!self->items[i])
+            return NULL;
+    }
+
+    Py_INCREF(self->items[i]);
+    return self->items[i];
+}
+
+static Py_ssize_t PyLazyList_length(PyLazyList *self)
+{
+    return self->len;
+}
+
+static PyObject *PyLazyList_item(PyLazyList *self, Py_ssize_t i)
+{
+    if (i < 0 || i >= self->len)
+        return PyErr_Format(PyExc_IndexError, "list index out of range");
+
+    return lazylist_get(self, i);
+}
+
+static PyObject *PyLazyList_slice(PyLazyList *self, Py_ssize_t ilow, Py_ssize_t ihigh)
+{
+    PyObject *list;
+    Py_ssize_t i;
+
+    if (ilow < 0)
+        ilow = 0;
+    if (ihigh > self->len)
+        ihigh = self->len;
+    if (ihigh < ilow)
+        ihigh = ilow;
+
+    list = PyList_New(ihigh - ilow);
+    if (!list)
+        return NULL;
+
+    for (i = ilow; i < ihigh; i++)
+    {
+        PyObject *obj = lazylist_get(self, i);
+        if (!obj)
+        {
+            Py_DECREF(list);
+            return NULL;
+        }
+
+        PyList_SET_ITEM(list, i - ilow, obj);
+    }
+
+    return list;
+}
+
+static PySequenceMethods PyLazyList_as_sequence = {
+    (lenfunc)PyLazyList_length,         /* sq_length */
+    0,                                  /* sq_concat */
+    0,                                  /* sq_repeat */
+    (ssizeargfunc)PyLazyList_item,      /* sq_item */
+    (ssizessizeargfunc)PyLazyList_slice, /* sq_slice */
+    0,                                  /* sq_ass_item */
+    0,                                  /* sq_ass_slice */
+    0,                                  /* sq_contains */
+};
+
+PyTypeObject PyLazyListType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "irssi.LazyList",            /*tp_name*/
+    sizeof(PyLazyList),             /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)PyLazyList_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    &PyLazyList_as_sequence,   /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+    "PyLazyList objects",           /* tp_doc */
+    0,		               /* tp_traverse */
+    0,		               /* tp_clear */
+    0,		               /* tp_richcompare */
+    0,		               /* tp_weaklistoffset */
+    0,		               /* tp_iter */
+    0,		               /* tp_iternext */
+    0,                         /* tp_methods */
+    0,                      /* tp_members */
+    0,                         /* tp_getset */
+    0,          /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    0,      /* tp_init */
+    0,                         /* tp_alloc */
+    0,                         /* tp_new */
+};
+
+/* lazy list factory function */
+PyObject *pylazylist_new(GSList *list, int managed, PyObject *(*init)(void *, int))
+{
+    PyLazyList *pylist;
+    int i;
+
+    pylist = py_inst(PyLazyList, PyLazyListType);
+    if (!pylist)
+        return NULL;
+
+    pylist->len = g_slist_length(list);
+    pylist->recs = g_new(void *, pylist->len + 1);
+    pylist->items = g_new0(PyObject *, pylist->len + 1);
+    pylist->managed = managed;
+    pylist->init = init;
+
+    for (i = 0; list != NULL; list = list->next, i++)
+        pylist->recs[i] = list->data;
+
+    return (PyObject *)pylist;
+}
+
+/* Called when the emit is over. If a handler kept the list, the remaining
+ * wrappers are made now, while the records are still valid.
+ */
+void pylazylist_release(PyObject *obj)
+{
+    PyLazyList *self = (PyLazyList *)obj;
+    int i;
+
+    g_return_if_fail(pylazylist_check(obj));
+
+    if (!self->recs)
+        return;
+
+    if (obj->ob_refcnt > 1)
+    {
+        for (i = 0; i < self->len; i++)
+        {
+            PyObject *item = lazylist_get(self, i);
+            if (!item)
+            {
+                PyErr_Print();
+                continue;
+            }
+
+            Py_DECREF(item);
+        }
+    }
+
+    g_free(self->recs);
+    self->recs = NULL;
+}
+
+int lazylist_object_init(void) 
+{
+    g_return_val_if_fail(py_module != NULL, 0);
+
+    if (PyType_Ready(&PyLazyListType) < 0)
+        return 0;
+    
+    Py_INCREF(&PyLazyListType);
+    PyModule_AddObject(py_module, "LazyList", (PyObject *)&PyLazyListType);
+
+    return 1;
+}
@@ -0,0 +1,29 @@
+#ifndef _LAZYLIST_OBJECT_H_
+#define _LAZYLIST_OBJECT_H_
+
+#include <Python.h>
+#include <glib.h>
+#include "base-objects.h"
+
+/* Read-only sequence over a GSList of records. Wrappers are made on first 
+ * access. The records are only valid while the signal is being emitted, so
+ * the list must be released before the emit returns.
+ */
+typedef struct
+{
+    PyObject_HEAD
+    void **recs; /* NULL after release */
+    PyObject **items;
+    int len;
+    int managed;
+    PyObject *(*init)(void *, int);
+} PyLazyList;
+
+extern PyTypeObject PyLazyListType;
+
+int lazylist_object_init(void);
+PyObject *pylazylist_new(GSList *list, int managed, PyObject *(*init)(void *, int));
+void pylazylist_release(PyObject *obj);
+#define pylazylist_check(op) PyObject_TypeCheck(op, &PyLazyListType)
+
+#endif
@@ -26,7 +26,7 @@
 #include "pycore.h"
 
 static LOG_ITEM_REC *find_item(LOG_REC *log, PyLogitem *item);
-static void log_cleanup(LOG_REC *log);
+static void log_cleanup(PyLog *pylog);
 static int logtype(int *type, int target, int window);
 
 /* find/convert a py log item */
@@ -48,22 +48,16 @@ static LOG_ITEM_REC *find_item(LOG_REC *log, PyLogitem *item)
 }
 
 /* monitor "log remove" signal */
-static void log_cleanup(LOG_REC *log)
+static void log_cleanup(PyLog *pylog)
 {
-    PyLog *pylog = signal_get_user_data();
-
-    if (log == pylog->data)
-    {
-        pylog->data = NULL;
-        pylog->cleanup_installed = 0;
-        signal_remove_data("log remove", log_cleanup, pylog);
-    }
+    pylog->data = NULL;
+    pylog->cleanup_installed = 0;
 }
 
 static void PyLog_dealloc(PyLog *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("log remove", log_cleanup, self);
+        py_cleanup_remove(CLEANUP_LOG, self->data, (PyObject *)self);
 
     if (self->data && !g_slist_find(logs, self->data))
     {
@@ -119,7 +113,7 @@ static int PyLog_init(PyLog *self, PyObject *args, PyObject *kwds)
    
     self->data = log;
     self->cleanup_installed = 1;
-    signal_add_last_data("log remove", log_cleanup, self);
+    py_cleanup_add(CLEANUP_LOG, self->data, (PyObject *)self, (CleanupFunc)log_cleanup);
     
     return 0;
 }
@@ -478,7 +472,7 @@ PyObject *pylog_new(void *log)
 
     pylog->data = log;
     pylog->cleanup_installed = 1;
-    signal_add_last_data("log remove", log_cleanup, pylog);
+    py_cleanup_add(CLEANUP_LOG, pylog->data, (PyObject *)pylog, (CleanupFunc)log_cleanup);
 
     return (PyObject *)pylog;
 }
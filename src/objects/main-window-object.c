@@ -28,22 +28,16 @@
 #define MW(data) ((MAIN_WINDOW_REC *) data)
 
 /* monitor "mainwindow destroyed" signal */
-static void main_window_cleanup(MAIN_WINDOW_REC *mw)
+static void main_window_cleanup(PyMainWindow *pymw)
 {
-    PyMainWindow *pymw = signal_get_user_data();
-
-    if (mw == pymw->data)
-    {
-        pymw->data = NULL;
-        pymw->cleanup_installed = 0;
-        signal_remove_data("mainwindow destroyed", main_window_cleanup, pymw);
-    }
+    pymw->data = NULL;
+    pymw->cleanup_installed = 0;
 }
 
 static void PyMainWindow_dealloc(PyMainWindow *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("mainwindow destroyed", main_window_cleanup, self); 
+        py_cleanup_remove(CLEANUP_MAINWINDOW, self->data, (PyObject *)self);
 
     Py_XDECREF(self->active);
     self->ob_type->tp_free((PyObject*)self);
@@ -200,7 +194,7 @@ PyObject *pymain_window_new(MAIN_WINDOW_REC *mw)
     pymw->active = pyactive;
     pymw->data = mw;
     pymw->cleanup_installed = 1;
-    signal_add_last_data("mainwindow destroyed", main_window_cleanup, pymw);
+    py_cleanup_add(CLEANUP_MAINWINDOW, pymw->data, (PyObject *)pymw, (CleanupFunc)main_window_cleanup);
 
     return (PyObject *)pymw;
 }
@@ -28,22 +28,16 @@
 #define NETSPLIT(ns) ((NETSPLIT_REC*)ns)
 
 /* monitor "netsplit remove" signal */
-static void netsplit_cleanup(NETSPLIT_REC *netsplit)
+static void netsplit_cleanup(PyNetsplit *pynetsplit)
 {
-    PyNetsplit *pynetsplit = signal_get_user_data();
-
-    if (netsplit == pynetsplit->data)
-    {
-        pynetsplit->data = NULL;
-        pynetsplit->cleanup_installed = 0;
-        signal_remove_data("netsplit remove", netsplit_cleanup, pynetsplit);
-    }
+    pynetsplit->data = NULL;
+    pynetsplit->cleanup_installed = 0;
 }
 
 static void PyNetsplit_dealloc(PyNetsplit *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("netsplit remove", netsplit_cleanup, self); 
+        py_cleanup_remove(CLEANUP_NETSPLIT, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -185,7 +179,7 @@ PyObject *pynetsplit_new(void *netsplit)
 
     pynetsplit->data = netsplit;
     pynetsplit->cleanup_installed = 1;
-    signal_add_last_data("netsplit remove", netsplit_cleanup, pynetsplit);
+    py_cleanup_add(CLEANUP_NETSPLIT, pynetsplit->data, (PyObject *)pynetsplit, (CleanupFunc)netsplit_cleanup);
 
     return (PyObject *)pynetsplit;
 }
@@ -28,22 +28,16 @@
 #define NETSPLIT_SERVER(ns) ((NETSPLIT_SERVER_REC*)ns)
 
 /* monitor "netsplit remove" signal */
-static void netsplit_server_cleanup(NETSPLIT_SERVER_REC *netsplit)
+static void netsplit_server_cleanup(PyNetsplitServer *pynetsplit)
 {
-    PyNetsplitServer *pynetsplit = signal_get_user_data();
-
-    if (netsplit == pynetsplit->data)
-    {
-        pynetsplit->data = NULL;
-        pynetsplit->cleanup_installed = 0;
-        signal_remove_data("netsplit remove", netsplit_server_cleanup, pynetsplit);
-    }
+    pynetsplit->data = NULL;
+    pynetsplit->cleanup_installed = 0;
 }
 
 static void PyNetsplitServer_dealloc(PyNetsplitServer *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("netsplit remove", netsplit_server_cleanup, self); 
+        py_cleanup_remove(CLEANUP_NETSPLIT_SERVER, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -158,7 +152,7 @@ PyObject *pynetsplit_server_new(void *nss)
 
     pynss->data = nss;
     pynss->cleanup_installed = 1;
-    signal_add_last_data("netsplit server remove", netsplit_server_cleanup, pynss);
+    py_cleanup_add(CLEANUP_NETSPLIT_SERVER, pynss->data, (PyObject *)pynss, (CleanupFunc)netsplit_server_cleanup);
 
     return (PyObject *)pynss;
 }
@@ -25,23 +25,18 @@
 #include "pyirssi.h"
 #include "pycore.h"
 #include "pyutils.h"
+#include "factory.h"
 
-static void nick_cleanup(CHANNEL_REC *chan, NICK_REC *nick)
+static void nick_cleanup(PyNick *pynick)
 {
-    PyNick *pynick = signal_get_user_data();
-
-    if (nick == pynick->data)
-    {
-        pynick->data = NULL;
-        pynick->cleanup_installed = 0;
-        signal_remove_data("nicklist remove", nick_cleanup, pynick);
-    }
+    pynick->data = NULL;
+    pynick->cleanup_installed = 0;
 }
 
 static void PyNick_dealloc(PyNick *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("nicklist remove", nick_cleanup, self);
+        py_cleanup_remove(CLEANUP_NICK, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -232,7 +227,7 @@ PyObject *pynick_sub_new(void *nick, PyTypeObject *subclass)
 
     pynick->data = nick;
     pynick->base_name = name;
-    signal_add_last_data("nicklist remove", nick_cleanup, pynick);
+    py_cleanup_add(CLEANUP_NICK, pynick->data, (PyObject *)pynick, (CleanupFunc)nick_cleanup);
     pynick->cleanup_installed = 1;
 
     return (PyObject *)pynick;
@@ -23,26 +23,21 @@
 #include "pymodule.h"
 #include "notifylist-object.h"
 #include "pycore.h"
+#include "factory.h"
 
 #define NOTIFYLIST(nl) ((NOTIFYLIST_REC *)nl)
 
 /* monitor "notifylist remove" signal */
-static void notifylist_cleanup(NOTIFYLIST_REC *notifylist)
+static void notifylist_cleanup(PyNotifylist *pynotifylist)
 {
-    PyNotifylist *pynotifylist = signal_get_user_data();
-
-    if (notifylist == pynotifylist->data)
-    {
-        pynotifylist->data = NULL;
-        pynotifylist->cleanup_installed = 0;
-        signal_remove_data("notifylist remove", notifylist_cleanup, pynotifylist);
-    }
+    pynotifylist->data = NULL;
+    pynotifylist->cleanup_installed = 0;
 }
 
 static void PyNotifylist_dealloc(PyNotifylist *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("notifylist remove", notifylist_cleanup, self); 
+        py_cleanup_remove(CLEANUP_NOTIFYLIST, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -222,7 +217,7 @@ PyObject *pynotifylist_new(void *notifylist)
 
     pynotifylist->data = notifylist;
     pynotifylist->cleanup_installed = 1;
-    signal_add_last_data("notifylist remove", notifylist_cleanup, pynotifylist);
+    py_cleanup_add(CLEANUP_NOTIFYLIST, pynotifylist->data, (PyObject *)pynotifylist, (CleanupFunc)notifylist_cleanup);
 
     return (PyObject *)pynotifylist;
 }
@@ -23,24 +23,19 @@
 #include "pymodule.h"
 #include "process-object.h"
 #include "pycore.h"
+#include "factory.h"
 
 /* monitor "exec remove" signal */
-static void process_cleanup(PROCESS_REC *process, int status)
+static void process_cleanup(PyProcess *pyprocess)
 {
-    PyProcess *pyprocess = signal_get_user_data();
-
-    if (process == pyprocess->data)
-    {
-        pyprocess->data = NULL;
-        pyprocess->cleanup_installed = 0;
-        signal_remove_data("exec remove", process_cleanup, pyprocess);
-    }
+    pyprocess->data = NULL;
+    pyprocess->cleanup_installed = 0;
 }
 
 static void PyProcess_dealloc(PyProcess *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("exec remove", process_cleanup, self); 
+        py_cleanup_remove(CLEANUP_PROCESS, self->data, (PyObject *)self);
 
     Py_XDECREF(self->target_win);
     
@@ -223,7 +218,7 @@ PyObject *pyprocess_new(void *process)
 
     pyprocess->data = process;
     pyprocess->cleanup_installed = 1;
-    signal_add_last_data("exec remove", process_cleanup, pyprocess);
+    py_cleanup_add(CLEANUP_PROCESS, pyprocess->data, (PyObject *)pyprocess, (CleanupFunc)process_cleanup);
 
     return (PyObject *)pyprocess;
 }
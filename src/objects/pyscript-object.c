@@ -27,6 +27,9 @@
 #include "pysource.h"
 #include "pythemes.h"
 #include "pystatusbar.h"
+#include "pystats.h"
+#include "pyloader.h"
+#include "timer-object.h"
 
 /* handle cycles...
    Can't think of any reason why the user would put script into one of the lists
@@ -37,6 +40,7 @@ static int PyScript_traverse(PyScript *self, visitproc visit, void *arg)
     Py_VISIT(self->module);
     Py_VISIT(self->argv);
     Py_VISIT(self->modules);
+    Py_VISIT(self->loop);
 
     return 0;
 }
@@ -46,6 +50,7 @@ static int PyScript_clear(PyScript *self)
     Py_CLEAR(self->module);
     Py_CLEAR(self->argv);
     Py_CLEAR(self->modules);
+    Py_CLEAR(self->loop);
 
     return 0;
 }
@@ -55,6 +60,7 @@ static void PyScript_dealloc(PyScript* self)
     PyScript_clear(self);
     pyscript_remove_signals((PyObject*)self);
     pyscript_remove_sources((PyObject*)self);
+    pyscript_remove_timers((PyObject*)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -88,52 +94,147 @@ error:
 }
 
 PyDoc_STRVAR(PyScript_command_bind_doc,
-    "command_bind(command, func, catetory=None, priority=SIGNAL_PRIORITY_DEFAULT) -> None\n"
+    "command_bind(command, func, catetory=None, priority=SIGNAL_PRIORITY_DEFAULT, tag=None, target=None) -> None\n"
     "\n"
     "Add handler for a command\n"
+    "\n"
+    "If tag or target is given, func is only called when the command is run\n"
+    "on a server with that tag or in a window item with that name.\n"
 );
 static PyObject *PyScript_command_bind(PyScript *self, PyObject *args, PyObject *kwds)
 {
-    static char *kwlist[] = {"cmd", "func", "category", "priority", NULL};
+    static char *kwlist[] = {"cmd", "func", "category", "priority", 
+        "tag", "target", NULL};
     char *cmd;
     PyObject *func;
     char *category = NULL;
     int priority = SIGNAL_PRIORITY_DEFAULT; 
+    PY_SIGNAL_FILTER_REC filter;
+
+    memset(&filter, 0, sizeof filter);
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sO|zi", kwlist, 
-                &cmd, &func, &category, &priority))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sO|zizz", kwlist, 
+                &cmd, &func, &category, &priority, &filter.tag, &filter.target))
         return NULL;
 
     if (!PyCallable_Check(func))
         return PyErr_Format(PyExc_TypeError, "func must be callable");
   
-    if (!pysignals_command_bind_list(&self->signals, cmd, func, category, priority))
+    if (!pysignals_command_bind_table(&self->signals, cmd, func, category, 
+                priority, &filter))
+    {
+        if (PyErr_Occurred())
+            return NULL;
         return PyErr_Format(PyExc_RuntimeError, "unable to bind command");
+    }
     
     Py_RETURN_NONE;
 }
 
 PyDoc_STRVAR(PyScript_signal_add_doc,
-    "signal_add(signal, func, priority=SIGNAL_PRIORITY_DEFAULT) -> None\n"
+    "signal_add(signal, func, priority=SIGNAL_PRIORITY_DEFAULT, lazy=False, tag=None, target=None, mask=None, level=0, parsed=False) -> None\n"
+    "\n"
+    "Add handler for signal\n"
+    "\n"
+    "With lazy set, func only receives as many args as it declares and\n"
+    "nick lists are passed as LazyList sequences whose Nick objects are\n"
+    "made on access. A list kept past the handler is filled in when the\n"
+    "signal is done.\n"
+    "\n"
+    "The filters are checked before any argument is converted. func is\n"
+    "only called when all that are given match:\n"
+    "  tag    - tag of the server the signal is for\n"
+    "  target - channel or query name (case insensitive)\n"
+    "  mask   - nick!user@host mask of the nick that caused the signal\n"
+    "  level  - MSGLEVEL_* bits, any of which must be set on a TextDest arg\n"
+    "ValueError is raised if the signal has no argument a filter can use.\n"
     "\n"
-    "Add handler for signal"
+    "With parsed set, for \"server event\", \"event <cmd>\" and \"redir <cmd>\"\n"
+    "only, func is called as func(server, msg) where msg is an IrcMessage.\n"
 );
 static PyObject *PyScript_signal_add(PyScript *self, PyObject *args, PyObject *kwds)
 {
-    static char *kwlist[] = {"signal", "func", "priority", NULL};
+    static char *kwlist[] = {"signal", "func", "priority", "lazy", 
+        "tag", "target", "mask", "level", "parsed", NULL};
     char *signal;
     PyObject *func;
     int priority = SIGNAL_PRIORITY_DEFAULT; 
+    int lazy = 0;
+    int parsed = 0;
+    int flags = 0;
+    PY_SIGNAL_FILTER_REC filter;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sO|i", kwlist, 
-                &signal, &func, &priority))
+    memset(&filter, 0, sizeof filter);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sO|iizzzii", kwlist, 
+                &signal, &func, &priority, &lazy, 
+                &filter.tag, &filter.target, &filter.mask, &filter.level,
+                &parsed))
         return NULL;
 
     if (!PyCallable_Check(func))
         return PyErr_Format(PyExc_TypeError, "func must be callable");
 
-    if (!pysignals_signal_add_list(&self->signals, signal, func, priority))
+    if (lazy)
+        flags |= PY_SIGNAL_LAZY;
+    if (parsed)
+        flags |= PY_SIGNAL_PARSED;
+
+    if (!pysignals_signal_add_table(&self->signals, signal, func, priority, 
+                flags, &filter))
+    {
+        if (PyErr_Occurred())
+            return NULL;
         return PyErr_Format(PyExc_KeyError, "unable to find signal, '%s'", signal);
+    }
+    
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(PyScript_signal_add_batched_doc,
+    "signal_add_batched(signal, func, size=100, msecs=1000, priority=SIGNAL_PRIORITY_DEFAULT, tag=None, target=None, mask=None, level=0) -> None\n"
+    "\n"
+    "Add handler that receives signals in batches\n"
+    "\n"
+    "func is called with one argument, a list of arg tuples, once size\n"
+    "signals are queued or msecs after the first one, whichever is first.\n"
+    "With msecs=0 the batch is flushed when irssi is idle. The handler\n"
+    "can't stop the signal or change its args. Objects that are destroyed\n"
+    "before the flush, and TextDest args, are passed as invalid wrappers.\n"
+    "A partly filled batch is dropped when the handler is removed.\n"
+    "The filters are the same as for signal_add().\n"
+);
+static PyObject *PyScript_signal_add_batched(PyScript *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"signal", "func", "size", "msecs", "priority", 
+        "tag", "target", "mask", "level", NULL};
+    char *signal;
+    PyObject *func;
+    int size = 100;
+    int msecs = 1000;
+    int priority = SIGNAL_PRIORITY_DEFAULT; 
+    PY_SIGNAL_FILTER_REC filter;
+
+    memset(&filter, 0, sizeof filter);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sO|iiizzzi", kwlist, 
+                &signal, &func, &size, &msecs, &priority, 
+                &filter.tag, &filter.target, &filter.mask, &filter.level))
+        return NULL;
+
+    if (!PyCallable_Check(func))
+        return PyErr_Format(PyExc_TypeError, "func must be callable");
+
+    if (size < 1 || msecs < 0)
+        return PyErr_Format(PyExc_ValueError, "size must be positive and msecs not negative");
+
+    if (!pysignals_signal_add_batched_table(&self->signals, signal, func, 
+                priority, size, msecs, &filter))
+    {
+        if (PyErr_Occurred())
+            return NULL;
+        return PyErr_Format(PyExc_KeyError, "unable to find signal, '%s'", signal);
+    }
     
     Py_RETURN_NONE;
 }
@@ -159,7 +260,7 @@ static PyObject *PyScript_signal_remove(PyScript *self, PyObject *args, PyObject
     if (func == Py_None)
         func = NULL;
     
-    if (!pysignals_remove_search(&self->signals, signal, func, PSG_SIGNAL))
+    if (!pysignals_remove_search(self->signals, signal, func, PSG_SIGNAL))
         return PyErr_Format(PyExc_KeyError, "can't find signal");
     
     Py_RETURN_NONE;
@@ -186,7 +287,7 @@ static PyObject *PyScript_command_unbind(PyScript *self, PyObject *args, PyObjec
     if (func == Py_None)
         func = NULL;
 
-    if (!pysignals_remove_search(&self->signals, command, func, PSG_COMMAND))
+    if (!pysignals_remove_search(self->signals, command, func, PSG_COMMAND))
         return PyErr_Format(PyExc_KeyError, "can't find command");
 
     Py_RETURN_NONE;
@@ -319,6 +420,43 @@ static PyObject *PyScript_timeout_add(PyScript *self, PyObject *args, PyObject *
     return PyInt_FromLong(ret);
 }
 
+PyDoc_STRVAR(PyScript_timer_doc,
+    "timer(msecs, func, data=None, repeat=False, tolerance=0) -> Timer\n"
+    "\n"
+    "Call func once after 'msecs' milliseconds, or every 'msecs' milliseconds\n"
+    "if repeat is True, until Timer.cancel() is called. The return value\n"
+    "of func is ignored. func may run up to 'tolerance' milliseconds late,\n"
+    "so that timers due at about the same time run together.\n"
+    "\n"
+    "func is called as func(data) or func(), depending on whether data\n"
+    "is specified or not. Unlike timeout_add(), adding and cancelling\n"
+    "stays cheap with many thousands of timers.\n"
+);
+static PyObject *PyScript_timer(PyScript *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"msecs", "func", "data", "repeat", "tolerance", NULL};
+    int msecs = 0;
+    PyObject *func = NULL;
+    PyObject *data = NULL;
+    int repeat = 0;
+    int tolerance = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "iO|Oii", kwlist, 
+           &msecs, &func, &data, &repeat, &tolerance))
+        return NULL;
+
+    if (msecs < 0 || tolerance < 0)
+        return PyErr_Format(PyExc_ValueError, "msecs and tolerance must not be negative");
+
+    if (repeat && msecs < 1)
+        return PyErr_Format(PyExc_ValueError, "msecs must be positive for a repeating timer");
+    
+    if (!PyCallable_Check(func))
+        return PyErr_Format(PyExc_TypeError, "func not callable");
+
+    return pytimer_object_new((PyObject *)self, msecs, func, data, repeat, tolerance);
+}
+
 PyDoc_STRVAR(PyScript_io_add_watch_doc,
     "io_add_watch(fd, func, data=None, condition=IO_IN|IO_PRI) -> int source tag\n"
 );
@@ -348,6 +486,55 @@ static PyObject *PyScript_io_add_watch(PyScript *self, PyObject *args, PyObject
     return PyInt_FromLong(ret);
 }
 
+PyDoc_STRVAR(PyScript_io_add_reader_doc,
+    "io_add_reader(fd, func, data=None, delimiter='\\n', size=0, max_size=65536, keep_delimiter=False) -> int source tag\n"
+    "\n"
+    "Read fd from the main loop and call func(records[, data]) with a list\n"
+    "of the whole records read, split on delimiter or, if size is given,\n"
+    "in fixed size frames. Records leave out the delimiter unless\n"
+    "keep_delimiter is True; then ''.join(records) is exactly the data\n"
+    "read. Records longer than max_size are split. At end of file any partial record is\n"
+    "passed, then func(None[, data]) is called and the reader is removed.\n"
+);
+static PyObject *PyScript_io_add_reader(PyScript *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"fd", "func", "data", "delimiter", "size", "max_size", 
+        "keep_delimiter", NULL};
+    int fd = 0;
+    PyObject *pyfd = NULL;
+    PyObject *func = NULL;
+    PyObject *data = NULL;
+    char *delim = "\n";
+    int delim_len = 1;
+    int size = 0;
+    int max_size = 65536;
+    int keep_delim = 0;
+    int ret;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|Os#iii", kwlist, 
+           &pyfd, &func, &data, &delim, &delim_len, &size, &max_size, 
+           &keep_delim))
+        return NULL;
+
+    fd = PyObject_AsFileDescriptor(pyfd);
+    if (fd < 0)
+        return NULL;
+   
+    if (!PyCallable_Check(func))
+        return PyErr_Format(PyExc_TypeError, "func not callable");
+
+    if (size < 0 || max_size < 0)
+        return PyErr_Format(PyExc_ValueError, "size and max_size must not be negative");
+
+    if (size == 0 && delim_len == 0)
+        return PyErr_Format(PyExc_ValueError, "need a delimiter or a frame size");
+    
+    ret = pysource_io_add_reader_list(&self->sources, fd, func, data, 
+            delim, delim_len, keep_delim, size, max_size);
+
+    return PyInt_FromLong(ret);
+}
+
 PyDoc_STRVAR(PyScript_source_remove_doc,
     "source_remove(tag) -> bool\n"
     "\n"
@@ -589,6 +776,8 @@ static PyMethodDef PyScript_methods[] = {
         PyScript_command_bind_doc},
     {"signal_add", (PyCFunction)PyScript_signal_add, METH_VARARGS | METH_KEYWORDS,
         PyScript_signal_add_doc},
+    {"signal_add_batched", (PyCFunction)PyScript_signal_add_batched, METH_VARARGS | METH_KEYWORDS,
+        PyScript_signal_add_batched_doc},
     {"signal_remove", (PyCFunction)PyScript_signal_remove, METH_VARARGS | METH_KEYWORDS,
         PyScript_signal_remove_doc},
     {"command_unbind", (PyCFunction)PyScript_command_unbind, METH_VARARGS | METH_KEYWORDS,
@@ -599,8 +788,12 @@ static PyMethodDef PyScript_methods[] = {
         PyScript_signal_unregister_doc},
     {"timeout_add", (PyCFunction)PyScript_timeout_add, METH_VARARGS | METH_KEYWORDS,
         PyScript_timeout_add_doc},
+    {"timer", (PyCFunction)PyScript_timer, METH_VARARGS | METH_KEYWORDS,
+        PyScript_timer_doc},
     {"io_add_watch", (PyCFunction)PyScript_io_add_watch, METH_VARARGS | METH_KEYWORDS,
         PyScript_io_add_watch_doc},
+    {"io_add_reader", (PyCFunction)PyScript_io_add_reader, METH_VARARGS | METH_KEYWORDS,
+        PyScript_io_add_reader_doc},
     {"source_remove", (PyCFunction)PyScript_source_remove, METH_VARARGS | METH_KEYWORDS,
         PyScript_source_remove_doc},
     {"settings_add_str", (PyCFunction)PyScript_settings_add_str, METH_VARARGS | METH_KEYWORDS,
@@ -628,6 +821,7 @@ static PyMemberDef PyScript_members[] = {
     {"argv", T_OBJECT, offsetof(PyScript, argv), 0, "Script arguments"},
     {"module", T_OBJECT_EX, offsetof(PyScript, module), RO, "Script module"},
     {"modules", T_OBJECT_EX, offsetof(PyScript, modules), 0, "Imported modules"},
+    {"loop", T_OBJECT, offsetof(PyScript, loop), 0, "Event loop, see irssi_loop"},
     {NULL}  /* Sentinel */
 };
 
@@ -712,6 +906,7 @@ PyObject *pyscript_new(PyObject *module, char **argv)
 
 void pyscript_remove_signals(PyObject *script)
 {
+    GHashTable *table;
     GSList *node;
     PyScript *self;
    
@@ -719,10 +914,11 @@ void pyscript_remove_signals(PyObject *script)
     
     self = (PyScript *) script;
 
-    /* remove bound signals */
-    pysignals_remove_list(self->signals);
-    g_slist_free(self->signals);
+    /* remove bound signals; detach the table first, since dropping a 
+       handler can run code that unbinds others */
+    table = self->signals;
     self->signals = NULL;
+    pysignals_remove_table(table);
 
     /* remove registered signals */
     for (node = self->registered_signals; node; node = node->next)
@@ -735,6 +931,15 @@ void pyscript_remove_signals(PyObject *script)
     self->registered_signals = NULL;
 }
 
+/* resume bindings suspended by the watchdog; if name is given, only 
+   that signal or command. Returns the number resumed. */
+int pyscript_resume_signals(PyObject *script, const char *name)
+{
+    g_return_val_if_fail(pyscript_check(script), 0);
+
+    return pysignals_resume_table(((PyScript *)script)->signals, name);
+}
+
 void pyscript_remove_sources(PyObject *script)
 {
     GSList *node;
@@ -756,6 +961,22 @@ void pyscript_remove_sources(PyObject *script)
     g_return_if_fail(self->sources == NULL);
 }
 
+void pyscript_remove_timers(PyObject *script)
+{
+    PyScript *self;
+
+    g_return_if_fail(pyscript_check(script));
+
+    self = (PyScript *) script;
+
+    /* each cancel removes its own link */
+    while (self->timers)
+        pytimer_object_cancel(self->timers->data);
+
+    pystats_remove(self->timer_stats);
+    self->timer_stats = NULL;
+}
+
 void pyscript_remove_settings(PyObject *script)
 {
     PyScript *self;
@@ -798,10 +1019,41 @@ void pyscript_clear_modules(PyObject *script)
     PyDict_Clear(self->modules);
 }
 
+/* Cancel the tasks of the script's event loop. This runs before the 
+ * sources and timers are removed so that the tasks can finish up.
+ */
+void pyscript_close_loop(PyObject *script)
+{
+    PyScript *self;
+    PyObject *loop, *prev, *ret;
+
+    g_return_if_fail(pyscript_check(script));
+
+    self = (PyScript *) script;
+    loop = self->loop;
+    if (!loop)
+        return;
+
+    self->loop = NULL;
+    if (loop != Py_None)
+    {
+        prev = pyloader_enter_script(script);
+        ret = PyObject_CallMethod(loop, "close", NULL);
+        if (!ret)
+            PyErr_Print();
+        Py_XDECREF(ret);
+        pyloader_leave_script(prev);
+    }
+
+    Py_DECREF(loop);
+}
+
 void pyscript_cleanup(PyObject *script)
 {
+    pyscript_close_loop(script);
     pyscript_remove_signals(script);
     pyscript_remove_sources(script);
+    pyscript_remove_timers(script);
     pyscript_remove_settings(script);
     pyscript_remove_themes(script);
     pyscript_remove_statusbars(script);
@@ -8,10 +8,16 @@ typedef struct {
     PyObject *module; /* module object */ 
     PyObject *argv;  /* list of argument strings from the load command */
     PyObject *modules; /* dict of imported modules for script */
-    GSList *signals; /* list of bound signals and commands */
+    GHashTable *signals; /* bound signals and commands, see pysignals.h */
     GSList *registered_signals; /* list of signal names registered */
     GSList *sources; /* list of io and timeout sources */
+    GList *timers; /* pending Timer objects */
+    struct _PY_STATS_REC *timer_stats; /* shared by the timers */
     GSList *settings; /* list of settings from settings_add_*() */
+    PyObject *loop; /* irssi_loop.EventLoop, or NULL */
+    double load_time; /* seconds to compile and run the module */
+    int load_cached; /* code came from the bytecode cache */
+    unsigned long load_seq; /* orders /py list */
 } PyScript;
 
 extern PyTypeObject PyScriptType;
@@ -19,11 +25,14 @@ extern PyTypeObject PyScriptType;
 int pyscript_init(void);
 PyObject *pyscript_new(PyObject *module, char **argv);
 void pyscript_remove_signals(PyObject *script);
+int pyscript_resume_signals(PyObject *script, const char *name);
 void pyscript_remove_sources(PyObject *script);
+void pyscript_remove_timers(PyObject *script);
 void pyscript_remove_settings(PyObject *script);
 void pyscript_remove_themes(PyObject *script);
 void pyscript_remove_statusbars(PyObject *script);
 void pyscript_clear_modules(PyObject *script);
+void pyscript_close_loop(PyObject *script);
 void pyscript_cleanup(PyObject *script);
 #define pyscript_check(op) PyObject_TypeCheck(op, &PyScriptType)
 #define pyscript_get_name(scr) PyModule_GetName(((PyScript*)scr)->module)
@@ -26,24 +26,19 @@
 #include "query-object.h"
 #include "server-object.h"
 #include "pycore.h"
+#include "factory.h"
 
 /* monitor "query destroyed" signal */
-static void query_cleanup(QUERY_REC *query)
+static void query_cleanup(PyQuery *pyquery)
 {
-    PyQuery *pyquery = signal_get_user_data();
-
-    if (query == pyquery->data)
-    {
-        pyquery->data = NULL;
-        pyquery->cleanup_installed = 0;
-        signal_remove_data("query destroyed", query_cleanup, pyquery);
-    }
+    pyquery->data = NULL;
+    pyquery->cleanup_installed = 0;
 }
 
 static void PyQuery_dealloc(PyQuery *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("query destroyed", query_cleanup, self);
+        py_cleanup_remove(CLEANUP_QUERY, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -171,7 +166,7 @@ PyObject *pyquery_new(void *query)
     if (pyquery)
     {
         PyQuery *pyq = (PyQuery *)pyquery;
-        signal_add_last_data("query destroyed", query_cleanup, pyq);
+        py_cleanup_add(CLEANUP_QUERY, pyq->data, (PyObject *)pyq, (CleanupFunc)query_cleanup);
         pyq->cleanup_installed = 1;
     }
 
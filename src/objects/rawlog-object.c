@@ -22,6 +22,7 @@
 #include "pyirssi_irc.h"
 #include "pymodule.h"
 #include "rawlog-object.h"
+#include "ircmessage-object.h"
 #include "pycore.h"
 
 /* monitor "????" signal */
@@ -136,17 +137,28 @@ static PyObject *PyRawlog_destroy(PyRawlog *self, PyObject *args)
 PyDoc_STRVAR(PyRawlog_input_doc,
     "input(str) -> None\n"
     "\n"
-    "Send str to rawlog as input text.\n"
+    "Send str to rawlog as input text. str may also be an IrcMessage.\n"
 );
 static PyObject *PyRawlog_input(PyRawlog *self, PyObject *args, PyObject *kwds)
 {
     static char *kwlist[] = {"str", NULL};
-    char *str = "";
+    PyObject *obj;
+    char *str;
 
     RET_NULL_IF_INVALID(self->data);
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, 
-           &str))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, 
+           &obj))
+        return NULL;
+
+    if (pyircmessage_check(obj))
+    {
+        RET_NULL_IF_INVALID(((PyIrcMessage *)obj)->line);
+        obj = ((PyIrcMessage *)obj)->line;
+    }
+
+    str = PyString_AsString(obj);
+    if (!str)
         return NULL;
 
     rawlog_input(self->data, str);
@@ -25,28 +25,22 @@
 #include "pycore.h"
 #include "pyutils.h"
 
-static void server_cleanup(SERVER_REC *server)
+static void server_cleanup(PyServer *pyserver)
 {
-    PyServer *pyserver = signal_get_user_data();
+    if (pyserver->connect)
+        ((PyConnect *)pyserver->connect)->data = NULL;
 
-    if (server == pyserver->data)
-    {
-        if (pyserver->connect)
-            ((PyConnect *)pyserver->connect)->data = NULL;
-
-        if (pyserver->rawlog)
-            ((PyRawlog *)pyserver->rawlog)->data = NULL;
+    if (pyserver->rawlog)
+        ((PyRawlog *)pyserver->rawlog)->data = NULL;
 
-        pyserver->data = NULL;
-        pyserver->cleanup_installed = 0;
-        signal_remove_data("server disconnected", server_cleanup, pyserver);
-    }
+    pyserver->data = NULL;
+    pyserver->cleanup_installed = 0;
 }
 
 static void PyServer_dealloc(PyServer *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("server disconnected", server_cleanup, self);
+        py_cleanup_remove(CLEANUP_SERVER, self->data, (PyObject *)self);
 
     Py_XDECREF(self->connect);
     Py_XDECREF(self->rawlog);
@@ -800,7 +794,7 @@ PyObject *pyserver_sub_new(void *server, PyTypeObject *subclass)
 
     pyserver->base_name = SERVER_TYPE;
     pyserver->data = server;
-    signal_add_last_data("server disconnected", server_cleanup, pyserver);
+    py_cleanup_add(CLEANUP_SERVER, pyserver->data, (PyObject *)pyserver, (CleanupFunc)server_cleanup);
     pyserver->cleanup_installed = 1;
     pyserver->rawlog = rawlog;
     pyserver->connect = connect;
@@ -0,0 +1,243 @@
+/* 
+    irssi-python
+
+    Copyright (C) 2006 Christopher Davis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <Python.h>
+#include "pyirssi.h"
+#include "pymodule.h"
+#include "pysignals.h"
+#include "signal-object.h"
+
+static void PySignal_dealloc(PySignal *self)
+{
+    pysignals_handle_deinit(&self->handle);
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+static PyObject *PySignal_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PySignal *self;
+
+    self = (PySignal *)type->tp_alloc(type, 0);
+    if (!self)
+        return NULL;
+
+    return (PyObject *)self;
+}
+
+PyDoc_STRVAR(PySignal_doc,
+    "__init__(signal)\n"
+    "\n"
+    "Handle for emitting signal repeatedly. The signal is looked up once,\n"
+    "here, instead of on every emit. KeyError is raised if it is unknown.\n"
+);
+static int PySignal_init(PySignal *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"signal", NULL};
+    char *signal;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s", kwlist, &signal))
+        return -1;
+
+    if (self->handle.name)
+    {
+        PyErr_Format(PyExc_RuntimeError, "Signal already initialized");
+        return -1;
+    }
+
+    if (!pysignals_handle_init(&self->handle, signal))
+        return -1;
+
+    return 0;
+}
+
+static int signal_check_args(PyObject *args)
+{
+    if (PyTuple_GET_SIZE(args) > SIGNAL_MAX_ARGUMENTS)
+    {
+        PyErr_Format(PyExc_TypeError, 
+                "no more than %d arguments for signal accepted", SIGNAL_MAX_ARGUMENTS);
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Getters */
+PyDoc_STRVAR(PySignal_name_doc,
+    "Signal name"
+);
+static PyObject *PySignal_name_get(PySignal *self, void *closure)
+{
+    RET_NULL_IF_INVALID(self->handle.name);
+    return PyString_FromString(self->handle.name);
+}
+
+PyDoc_STRVAR(PySignal_id_doc,
+    "Irssi's id for the signal"
+);
+static PyObject *PySignal_id_get(PySignal *self, void *closure)
+{
+    RET_NULL_IF_INVALID(self->handle.name);
+    return PyInt_FromLong(self->handle.signal_id);
+}
+
+/* specialized getters/setters */
+static PyGetSetDef PySignal_getseters[] = {
+    {"name", (getter)PySignal_name_get, NULL,
+        PySignal_name_doc, NULL},
+    {"id", (getter)PySignal_id_get, NULL,
+        PySignal_id_doc, NULL},
+    {NULL}
+};
+
+/* Methods */
+PyDoc_STRVAR(PySignal_emit_doc,
+    "emit(*args) -> None\n"
+    "\n"
+    "Emit the signal with up to 6 arguments\n"
+);
+static PyObject *PySignal_emit(PySignal *self, PyObject *args)
+{
+    RET_NULL_IF_INVALID(self->handle.name);
+
+    if (!signal_check_args(args))
+        return NULL;
+
+    if (!pysignals_handle_emit(&self->handle, args))
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(PySignal_emit_many_doc,
+    "emit_many(seq) -> None\n"
+    "\n"
+    "Emit the signal once for each tuple of arguments in seq. Stops at the\n"
+    "first tuple that can't be converted.\n"
+);
+static PyObject *PySignal_emit_many(PySignal *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"seq", NULL};
+    PyObject *seq, *fast;
+    int i;
+
+    RET_NULL_IF_INVALID(self->handle.name);
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O", kwlist, &seq))
+        return NULL;
+
+    fast = PySequence_Fast(seq, "emit_many needs a sequence of tuples");
+    if (!fast)
+        return NULL;
+
+    for (i = 0; i < PySequence_Fast_GET_SIZE(fast); i++)
+    {
+        PyObject *argtup = PySequence_Fast_GET_ITEM(fast, i);
+
+        if (!PyTuple_Check(argtup))
+        {
+            PyErr_Format(PyExc_TypeError, "item %d is not a tuple", i);
+            goto error;
+        }
+
+        if (!signal_check_args(argtup))
+            goto error;
+
+        /* a handler may change seq */
+        Py_INCREF(argtup);
+        if (!pysignals_handle_emit(&self->handle, argtup))
+        {
+            Py_DECREF(argtup);
+            goto error;
+        }
+        Py_DECREF(argtup);
+    }
+
+    Py_DECREF(fast);
+    Py_RETURN_NONE;
+
+error:
+    Py_DECREF(fast);
+    return NULL;
+}
+
+/* Methods for object */
+static PyMethodDef PySignal_methods[] = {
+    {"emit", (PyCFunction)PySignal_emit, METH_VARARGS,
+        PySignal_emit_doc},
+    {"emit_many", (PyCFunction)PySignal_emit_many, METH_VARARGS | METH_KEYWORDS,
+        PySignal_emit_many_doc},
+    {NULL}  /* Sentinel */
+};
+
+PyTypeObject PySignalType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "irssi.Signal",            /*tp_name*/
+    sizeof(PySignal),             /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)PySignal_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /*tp_flags*/
+    PySignal_doc,           /* tp_doc */
+    0,		               /* tp_traverse */
+    0,		               /* tp_clear */
+    0,		               /* tp_richcompare */
+    0,		               /* tp_weaklistoffset */
+    0,		               /* tp_iter */
+    0,		               /* tp_iternext */
+    PySignal_methods,             /* tp_methods */
+    0,                      /* tp_members */
+    PySignal_getseters,        /* tp_getset */
+    0,          /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    (initproc)PySignal_init,      /* tp_init */
+    0,                         /* tp_alloc */
+    PySignal_new,                 /* tp_new */
+};
+
+int signal_object_init(void) 
+{
+    g_return_val_if_fail(py_module != NULL, 0);
+
+    if (PyType_Ready(&PySignalType) < 0)
+        return 0;
+    
+    Py_INCREF(&PySignalType);
+    PyModule_AddObject(py_module, "Signal", (PyObject *)&PySignalType);
+
+    return 1;
+}
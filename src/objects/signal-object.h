@@ -0,0 +1,19 @@
+#ifndef _SIGNAL_OBJECT_H_
+#define _SIGNAL_OBJECT_H_
+
+#include <Python.h>
+#include "base-objects.h"
+#include "pysignals.h"
+
+typedef struct
+{
+    PyObject_HEAD
+    PY_SIGNAL_HANDLE_REC handle; /* name is NULL until __init__ */
+} PySignal;
+
+extern PyTypeObject PySignalType;
+
+int signal_object_init(void);
+#define pysignal_check(op) PyObject_TypeCheck(op, &PySignalType)
+
+#endif
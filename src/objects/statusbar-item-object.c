@@ -25,22 +25,16 @@
 #include "statusbar-item-object.h"
 
 /* monitor "statusbar item destroyed" signal */
-static void statusbar_item_cleanup(SBAR_ITEM_REC *sbar_item)
+static void statusbar_item_cleanup(PyStatusbarItem *pysbar_item)
 {
-    PyStatusbarItem *pysbar_item = signal_get_user_data();
-
-    if (sbar_item == pysbar_item->data)
-    {
-        pysbar_item->data = NULL;
-        pysbar_item->cleanup_installed = 0;
-        signal_remove_data("statusbar item_destroy", statusbar_item_cleanup, pysbar_item);
-    }
+    pysbar_item->data = NULL;
+    pysbar_item->cleanup_installed = 0;
 }
 
 static void PyStatusbarItem_dealloc(PyStatusbarItem *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("sbar_itemlist remove", statusbar_item_cleanup, self); 
+        py_cleanup_remove(CLEANUP_STATUSBAR_ITEM, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -254,7 +248,7 @@ PyObject *pystatusbar_item_new(void *sbar_item)
     
     pysbar_item->data = sbar_item;
     pysbar_item->cleanup_installed = 1;
-    signal_add_last_data("statusbar item destroyed", statusbar_item_cleanup, pysbar_item);
+    py_cleanup_add(CLEANUP_STATUSBAR_ITEM, pysbar_item->data, (PyObject *)pysbar_item, (CleanupFunc)statusbar_item_cleanup);
 
     return (PyObject *)pysbar_item;
 }
@@ -26,21 +26,16 @@
 #include "pycore.h"
 
 /* monitor "theme destroyed" signal */
-static void theme_cleanup(THEME_REC *rec)
+static void theme_cleanup(PyTheme *pytheme)
 {
-    PyTheme *pytheme = signal_get_user_data();
-    if (pytheme->data == rec)
-    {
-        pytheme->data = NULL;
-        pytheme->cleanup_installed = 0;
-        signal_remove_data("theme destroyed", theme_cleanup, pytheme);
-    }
+    pytheme->data = NULL;
+    pytheme->cleanup_installed = 0;
 }
 
 static void PyTheme_dealloc(PyTheme *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("theme destroyed", theme_cleanup, self);
+        py_cleanup_remove(CLEANUP_THEME, self->data, (PyObject *)self);
     
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -195,7 +190,7 @@ PyObject *pytheme_new(void *td)
         return NULL;
 
     pytheme->data = td;
-    signal_add_last_data("theme destroyed", theme_cleanup, pytheme);
+    py_cleanup_add(CLEANUP_THEME, pytheme->data, (PyObject *)pytheme, (CleanupFunc)theme_cleanup);
     pytheme->cleanup_installed = 1;
 
     return (PyObject *)pytheme;
@@ -0,0 +1,256 @@
+/* 
+    irssi-python
+
+    Copyright (C) 2006 Christopher Davis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <Python.h>
+#include "pyirssi.h"
+#include "pymodule.h"
+#include "pyloader.h"
+#include "pystats.h"
+#include "timer-object.h"
+#include "pyscript-object.h"
+
+/* A pending timer is referenced by its script's timer list, so it stays 
+ * alive without the script keeping the Timer object. The reference is 
+ * dropped when the timer is cancelled or a one shot timer fires.
+ */
+
+static void py_timer_detach(PyTimer *self)
+{
+    PyScript *script = (PyScript *)self->script;
+
+    script->timers = g_list_delete_link(script->timers, self->link);
+    self->link = NULL;
+    Py_DECREF(self);
+}
+
+static void py_timer_fire(PY_TIMER_REC *timer)
+{
+    PyTimer *self = timer->data;
+    PyScript *script = (PyScript *)self->script;
+    PY_STATS_REC *stats = script->timer_stats;
+    PyObject *ret, *prev;
+    double start;
+
+    Py_INCREF(self);
+
+    /* the wheel has already added a repeating timer back */
+    if (!pytimer_pending(timer))
+        py_timer_detach(self);
+
+    prev = pyloader_enter_script((PyObject *)script);
+    start = pystats_begin(stats);
+    if (self->data)
+        ret = PyObject_CallFunctionObjArgs(self->func, self->data, NULL);
+    else
+        ret = PyObject_CallFunctionObjArgs(self->func, NULL);
+    pystats_end(stats, start, ret != NULL);
+    pyloader_leave_script(prev);
+
+    if (!ret)
+        PyErr_Print();
+    else
+        Py_DECREF(ret);
+
+    Py_DECREF(self);
+}
+
+static void PyTimer_dealloc(PyTimer *self)
+{
+    Py_XDECREF(self->func);
+    Py_XDECREF(self->data);
+    self->ob_type->tp_free((PyObject*)self);
+}
+
+/* Getters */
+PyDoc_STRVAR(PyTimer_pending_doc,
+    "True until the timer is cancelled or a one shot timer has fired"
+);
+static PyObject *PyTimer_pending_get(PyTimer *self, void *closure)
+{
+    return PyBool_FromLong(self->link != NULL);
+}
+
+PyDoc_STRVAR(PyTimer_msecs_doc,
+    "Delay or period in milliseconds"
+);
+static PyObject *PyTimer_msecs_get(PyTimer *self, void *closure)
+{
+    return PyInt_FromLong(self->timer.msecs);
+}
+
+PyDoc_STRVAR(PyTimer_repeat_doc,
+    "True if the timer repeats"
+);
+static PyObject *PyTimer_repeat_get(PyTimer *self, void *closure)
+{
+    return PyBool_FromLong(self->timer.repeat);
+}
+
+PyDoc_STRVAR(PyTimer_tolerance_doc,
+    "Milliseconds the timer may fire late"
+);
+static PyObject *PyTimer_tolerance_get(PyTimer *self, void *closure)
+{
+    return PyInt_FromLong(self->timer.tolerance);
+}
+
+/* specialized getters/setters */
+static PyGetSetDef PyTimer_getseters[] = {
+    {"pending", (getter)PyTimer_pending_get, NULL,
+        PyTimer_pending_doc, NULL},
+    {"msecs", (getter)PyTimer_msecs_get, NULL,
+        PyTimer_msecs_doc, NULL},
+    {"repeat", (getter)PyTimer_repeat_get, NULL,
+        PyTimer_repeat_doc, NULL},
+    {"tolerance", (getter)PyTimer_tolerance_get, NULL,
+        PyTimer_tolerance_doc, NULL},
+    {NULL}
+};
+
+/* Methods */
+PyDoc_STRVAR(PyTimer_cancel_doc,
+    "cancel() -> bool\n"
+    "\n"
+    "Stop the timer. Return True if it was pending.\n"
+);
+static PyObject *PyTimer_cancel(PyTimer *self, PyObject *args)
+{
+    return PyBool_FromLong(pytimer_object_cancel((PyObject *)self));
+}
+
+/* Methods for object */
+static PyMethodDef PyTimer_methods[] = {
+    {"cancel", (PyCFunction)PyTimer_cancel, METH_NOARGS,
+        PyTimer_cancel_doc},
+    {NULL}  /* Sentinel */
+};
+
+PyDoc_STRVAR(PyTimer_doc,
+    "Timer from Script.timer()"
+);
+PyTypeObject PyTimerType = {
+    PyObject_HEAD_INIT(NULL)
+    0,                         /*ob_size*/
+    "irssi.Timer",             /*tp_name*/
+    sizeof(PyTimer),             /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)PyTimer_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+    PyTimer_doc,           /* tp_doc */
+    0,		               /* tp_traverse */
+    0,		               /* tp_clear */
+    0,		               /* tp_richcompare */
+    0,		               /* tp_weaklistoffset */
+    0,		               /* tp_iter */
+    0,		               /* tp_iternext */
+    PyTimer_methods,             /* tp_methods */
+    0,                      /* tp_members */
+    PyTimer_getseters,        /* tp_getset */
+    0,          /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    0,      /* tp_init */
+    0,                         /* tp_alloc */
+    0,                 /* tp_new */
+};
+
+/* Start a timer owned by script */
+PyObject *pytimer_object_new(PyObject *script, int msecs, PyObject *func, 
+        PyObject *data, int repeat, int tolerance)
+{
+    PyScript *owner = (PyScript *)script;
+    PyTimer *self;
+
+    g_return_val_if_fail(pyscript_check(script), NULL);
+
+    self = PyObject_New(PyTimer, &PyTimerType);
+    if (!self)
+        return NULL;
+
+    memset(&self->timer, 0, sizeof self->timer);
+    self->timer.msecs = msecs;
+    self->timer.tolerance = tolerance;
+    self->timer.repeat = repeat;
+    self->timer.func = py_timer_fire;
+    self->timer.data = self;
+
+    Py_INCREF(func);
+    Py_XINCREF(data);
+    self->func = func;
+    self->data = data;
+    self->script = script;
+
+    if (!owner->timer_stats)
+        owner->timer_stats = pystats_new(pyscript_get_name(script), "timer", "(all)");
+
+    /* reference for the script's list */
+    Py_INCREF(self);
+    owner->timers = g_list_prepend(owner->timers, self);
+    self->link = owner->timers;
+
+    pytimer_add(&self->timer);
+
+    return (PyObject *)self;
+}
+
+/* Returns 1 if the timer was pending */
+int pytimer_object_cancel(PyObject *timer)
+{
+    PyTimer *self = (PyTimer *)timer;
+
+    g_return_val_if_fail(pytimer_object_check(timer), 0);
+
+    if (!self->link)
+        return 0;
+
+    pytimer_cancel(&self->timer);
+    py_timer_detach(self);
+
+    return 1;
+}
+
+int timer_object_init(void) 
+{
+    g_return_val_if_fail(py_module != NULL, 0);
+
+    if (PyType_Ready(&PyTimerType) < 0)
+        return 0;
+    
+    Py_INCREF(&PyTimerType);
+    PyModule_AddObject(py_module, "Timer", (PyObject *)&PyTimerType);
+
+    return 1;
+}
@@ -0,0 +1,25 @@
+#ifndef _TIMER_OBJECT_H_
+#define _TIMER_OBJECT_H_
+
+#include <Python.h>
+#include "pytimer.h"
+
+typedef struct
+{
+    PyObject_HEAD
+    PY_TIMER_REC timer;
+    PyObject *func;
+    PyObject *data;
+    PyObject *script; /* owner, borrowed */
+    GList *link; /* in the owner's timer list while pending */
+} PyTimer;
+
+extern PyTypeObject PyTimerType;
+
+int timer_object_init(void);
+PyObject *pytimer_object_new(PyObject *script, int msecs, PyObject *func, 
+        PyObject *data, int repeat, int tolerance);
+int pytimer_object_cancel(PyObject *timer);
+#define pytimer_object_check(op) PyObject_TypeCheck(op, &PyTimerType)
+
+#endif
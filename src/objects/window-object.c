@@ -27,22 +27,16 @@
 #include "pyutils.h"
 
 /* monitor "window destroyed" signal */
-static void window_cleanup(WINDOW_REC *win)
+static void window_cleanup(PyWindow *pywindow)
 {
-    PyWindow *pywindow = signal_get_user_data();
-
-    if (win == pywindow->data)
-    {
-        pywindow->data = NULL;
-        pywindow->cleanup_installed = 0;
-        signal_remove_data("window destroyed", window_cleanup, pywindow);
-    }
+    pywindow->data = NULL;
+    pywindow->cleanup_installed = 0;
 }
 
 static void PyWindow_dealloc(PyWindow *self)
 {
     if (self->cleanup_installed)
-        signal_remove_data("window destroyed", window_cleanup, self); 
+        py_cleanup_remove(CLEANUP_WINDOW, self->data, (PyObject *)self);
 
     self->ob_type->tp_free((PyObject*)self);
 }
@@ -679,7 +673,7 @@ PyObject *pywindow_new(void *win)
 
     pywindow->data = win;
     pywindow->cleanup_installed = 1;
-    signal_add_last_data("window destroyed", window_cleanup, pywindow);
+    py_cleanup_add(CLEANUP_WINDOW, pywindow->data, (PyObject *)pywindow, (CleanupFunc)window_cleanup);
 
     return (PyObject *)pywindow;
 }
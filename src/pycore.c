@@ -22,14 +22,20 @@
 #include <string.h>
 #include <signal.h>
 #include <assert.h>
+#include <errno.h>
 #include "pyirssi.h"
 #include "pycore.h"
 #include "pyloader.h"
+#include "pyhost.h"
 #include "pymodule.h"
 #include "pysignals.h"
+#include "pysource.h"
 #include "pythemes.h"
 #include "pystatusbar.h"
+#include "pystats.h"
 #include "pyconstants.h"
+#include "pyfrozen.h"
+#include "pytimer.h"
 #include "factory.h"
 
 static void cmd_default(const char *data, SERVER_REC *server, void *item)
@@ -47,11 +53,13 @@ static void cmd_exec(const char *data)
     PyObject *d;
     PyObject *m;
     char *cmd;
+    int gil;
 
     if (!*data)
         cmd_return_error(CMDERR_NOT_ENOUGH_PARAMS);
 
     cmd = g_strconcat(data, "\n", NULL);
+    gil = python_gil_enter();
     
     m = PyImport_AddModule("__main__");
     if (!m)
@@ -73,11 +81,13 @@ error:
     g_free(cmd);
     if (PyErr_Occurred())
         PyErr_Print();
+    python_gil_leave(gil);
 }
 
 static void cmd_load(const char *data)
 {
     char **argv;
+    int gil;
 
     argv = g_strsplit(data, " ", -1);
     if (*argv == NULL || **argv == '\0')
@@ -86,7 +96,9 @@ static void cmd_load(const char *data)
         cmd_return_error(CMDERR_NOT_ENOUGH_PARAMS);
     }
 
+    gil = python_gil_enter();
     pyloader_load_script_argv(argv);
+    python_gil_leave(gil);
     g_strfreev(argv);
 }
 
@@ -94,6 +106,7 @@ static void cmd_unload(const char *data)
 {
     void *free_arg;
     char *script;
+    int gil;
 
     if (!cmd_get_params(data, &free_arg, 1, &script))
         return;
@@ -101,19 +114,66 @@ static void cmd_unload(const char *data)
     if (*script == '\0')
         cmd_param_error(CMDERR_NOT_ENOUGH_PARAMS);
 
-    pyloader_unload_script(script); 
+    gil = python_gil_enter();
+    if (!pyhost_stop(script))
+        pyloader_unload_script(script); 
+    python_gil_leave(gil);
     
     cmd_params_free(free_arg);
 }
 
+/* /py host <script> [args] runs script in a helper process, /py host 
+ * alone lists those scripts */
+static void cmd_host(const char *data)
+{
+    char buf[128];
+    char **argv;
+    GSList *list, *node;
+    int gil;
+
+    argv = g_strsplit(data, " ", -1);
+    if (*argv != NULL && **argv != '\0')
+    {
+        gil = python_gil_enter();
+        pyhost_start(argv);
+        python_gil_leave(gil);
+        g_strfreev(argv);
+        return;
+    }
+    g_strfreev(argv);
+
+    list = pyhost_list();
+    if (list == NULL)
+    {
+        printtext_string(NULL, NULL, MSGLEVEL_CLIENTERROR, "No python scripts are hosted");
+        return;
+    }
+
+    g_snprintf(buf, sizeof(buf), "%-15s %7s %10s %8s %s", "Name", "PID", "Events", "Dropped", "File");
+    printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, buf);
+    for (node = list; node != NULL; node = node->next)
+    {
+        PY_HOST_LIST_REC *item = node->data;
+
+        g_snprintf(buf, sizeof(buf), "%-15s %7d %10lu %8lu %s", item->name, 
+                item->pid, item->events, item->dropped, item->file);
+        printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, buf);
+    }
+
+    pyhost_list_destroy(&list);
+}
+
 static void cmd_list()
 {
     char buf[128];
     GSList *list;
+    int gil;
 
+    gil = python_gil_enter();
     list = pyloader_list();
+    python_gil_leave(gil);
 
-    g_snprintf(buf, sizeof(buf), "%-15s %s", "Name", "File");
+    g_snprintf(buf, sizeof(buf), "%-15s %9s %6s %s", "Name", "Load ms", "Timers", "File");
 
     if (list != NULL)
     {
@@ -123,10 +183,16 @@ static void cmd_list()
         for (node = list; node != NULL; node = node->next)
         {
             PY_LIST_REC *item = node->data;
-            g_snprintf(buf, sizeof(buf), "%-15s %s", item->name, item->file); 
+            if (item->pending)
+                g_snprintf(buf, sizeof(buf), "%-15s %9s %6s %s", item->name, "on use", "", item->file); 
+            else
+                g_snprintf(buf, sizeof(buf), "%-15s %8.1f%c %6d %s", item->name, 
+                        item->load_time * 1e3, item->load_cached? '*' : ' ', 
+                        item->timers, item->file); 
 
             printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, buf);
         }
+        printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, "* loaded from the bytecode cache");
     }
     else
         printtext_string(NULL, NULL, MSGLEVEL_CLIENTERROR, "No python scripts are loaded");
@@ -134,6 +200,177 @@ static void cmd_list()
     pyloader_list_destroy(&list);
 }
 
+static void cmd_resume(const char *data)
+{
+    void *free_arg;
+    char *name, *signame;
+    PyObject *script;
+    int count, gil;
+
+    if (!cmd_get_params(data, &free_arg, 2, &name, &signame))
+        return;
+
+    if (*name == '\0')
+        cmd_param_error(CMDERR_NOT_ENOUGH_PARAMS);
+
+    gil = python_gil_enter();
+    script = pyloader_find_script(name);
+    if (!script)
+    {
+        python_gil_leave(gil);
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, "%s is not loaded", name);
+        cmd_params_free(free_arg);
+        return;
+    }
+
+    count = pyscript_resume_signals(script, *signame? signame : NULL);
+    python_gil_leave(gil);
+    printtext(NULL, NULL, MSGLEVEL_CLIENTCRAP, "Python script %s: resumed %d handler%s",
+            name, count, count == 1? "" : "s");
+
+    cmd_params_free(free_arg);
+}
+
+/* Show how long each step of python_init took, or write it to a file */
+static void cmd_startup(const char *data)
+{
+    char buf[128];
+    void *free_arg;
+    char *fname, *path;
+    GSList *node;
+    FILE *fp = NULL;
+
+    if (!cmd_get_params(data, &free_arg, 1, &fname))
+        return;
+
+    if (*fname != '\0')
+    {
+        path = convert_home(fname);
+        fp = fopen(path, "w");
+        if (!fp)
+        {
+            printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, "Can't write %s: %s", 
+                    path, g_strerror(errno));
+            g_free(path);
+            cmd_params_free(free_arg);
+            return;
+        }
+        g_free(path);
+    }
+    else
+    {
+        g_snprintf(buf, sizeof(buf), "%-40s %10s", "Step", "ms");
+        printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, buf);
+    }
+
+    for (node = pystats_startup_list(); node != NULL; node = node->next)
+    {
+        PY_STARTUP_REC *rec = node->data;
+
+        if (fp)
+        {
+            /* tab separated for diffing between runs */
+            fprintf(fp, "%d\t%s\t%.3f\n", rec->depth, rec->name, rec->secs * 1e3);
+        }
+        else
+        {
+            g_snprintf(buf, sizeof(buf), "%*s%-*s %10.3f", rec->depth * 2, "", 
+                    40 - rec->depth * 2, rec->name, rec->secs * 1e3);
+            printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, buf);
+        }
+    }
+
+    if (fp)
+    {
+        fclose(fp);
+        printtext(NULL, NULL, MSGLEVEL_CLIENTCRAP, "Wrote startup times to %s", fname);
+    }
+
+    cmd_params_free(free_arg);
+}
+
+static void cmd_stats(const char *data)
+{
+    char buf[256];
+    GSList *list, *node;
+    GHashTable *scripts;
+
+    if (g_strcasecmp(data, "on") == 0 || g_strcasecmp(data, "off") == 0)
+    {
+        pystats_enabled = g_strcasecmp(data, "on") == 0;
+        printtext(NULL, NULL, MSGLEVEL_CLIENTCRAP, "Python stats are %s", 
+                pystats_enabled? "on" : "off");
+        return;
+    }
+    else if (g_strcasecmp(data, "reset") == 0)
+    {
+        pystats_reset();
+        return;
+    }
+    else if (*data)
+    {
+        printtext_string(NULL, NULL, MSGLEVEL_CLIENTERROR, "Usage: /py stats [on|off|reset]");
+        return;
+    }
+
+    list = pystats_list();
+    if (list == NULL)
+    {
+        printtext_string(NULL, NULL, MSGLEVEL_CLIENTERROR, "No python handlers are bound");
+        return;
+    }
+
+    if (!pystats_enabled)
+        printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, "Python stats are off, showing old counts");
+
+    g_snprintf(buf, sizeof(buf), "%-15s %-9s %-25s %8s %6s %10s %9s %9s", 
+            "Script", "Type", "Name", "Calls", "Errors", "Total ms", "Avg us", "Max us");
+    printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, buf);
+
+    /* script name -> total seconds, in the order scripts first appear */
+    scripts = g_hash_table_new(g_str_hash, g_str_equal);
+    for (node = list; node != NULL; node = node->next)
+    {
+        PY_STATS_REC *rec = node->data;
+        double *total;
+
+        if (rec->calls == 0)
+            continue;
+
+        g_snprintf(buf, sizeof(buf), "%-15s %-9s %-25s %8lu %6lu %10.1f %9.0f %9.0f", 
+                rec->script, rec->type, rec->name, rec->calls, rec->errors,
+                rec->total * 1e3, rec->total * 1e6 / rec->calls, rec->max * 1e6); 
+        printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, buf);
+
+        total = g_hash_table_lookup(scripts, rec->script);
+        if (!total)
+        {
+            total = g_new0(double, 1);
+            g_hash_table_insert(scripts, rec->script, total);
+        }
+        *total += rec->total;
+    }
+
+    printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, "Per script:");
+    for (node = list; node != NULL; node = node->next)
+    {
+        PY_STATS_REC *rec = node->data;
+        double *total = g_hash_table_lookup(scripts, rec->script);
+
+        if (!total)
+            continue;
+
+        g_snprintf(buf, sizeof(buf), "%-15s %10.1f ms", rec->script, *total * 1e3);
+        printtext_string(NULL, NULL, MSGLEVEL_CLIENTCRAP, buf);
+
+        g_hash_table_remove(scripts, rec->script);
+        g_free(total);
+    }
+
+    g_hash_table_destroy(scripts);
+    pystats_list_destroy(list);
+}
+
 #if 0
 /* why doesn't this get called? */
 static void intr_catch(int sig)
@@ -143,27 +380,141 @@ static void intr_catch(int sig)
 }
 #endif 
 
+/* Import the wrapper modules (irssi, irssi_startup and so on) from the 
+ * copies compiled into the module, unless they were compiled for another Python or 
+ * python_frozen_modules is off, which loads the installed files instead 
+ * (handy when editing them).
+ * Must run before Py_InitializeEx.
+ */
+static void py_frozen_init(void)
+{
+    settings_add_bool("python", "python_frozen_modules", TRUE);
+    if (!settings_get_bool("python_frozen_modules"))
+        return;
+
+    if (PyImport_GetMagicNumber() != pyfrozen_magic)
+    {
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+                "Python wrappers were built for another Python version, loading them from %s",
+                SCRIPTDIR);
+        return;
+    }
+
+    PyImport_FrozenModules = pyfrozen_modules;
+}
+
+#ifdef WITH_THREAD
+static PyThreadState *py_main_tstate;
+#endif
+
+/* The main thread holds the GIL only while a callback from irssi or GLib
+ * runs Python code, so threads started by scripts run both while irssi 
+ * waits for input and while it does its own work, such as drawing the 
+ * screen between handlers.
+ */
+int python_gil_enter(void)
+{
+#ifdef WITH_THREAD
+    return PyGILState_Ensure();
+#else
+    return 0;
+#endif
+}
+
+void python_gil_leave(int state)
+{
+#ifdef WITH_THREAD
+    PyGILState_Release((PyGILState_STATE)state);
+#endif
+}
+
+static void py_threads_init(void)
+{
+#ifdef WITH_THREAD
+    PyEval_InitThreads();
+#endif
+}
+
+/* Give up the GIL taken by Py_InitializeEx, last thing in python_init */
+static void py_threads_start(void)
+{
+#ifdef WITH_THREAD
+    py_main_tstate = PyEval_SaveThread();
+#endif
+}
+
+/* Take it back, first thing in python_deinit */
+static void py_threads_deinit(void)
+{
+#ifdef WITH_THREAD
+    if (py_main_tstate)
+        PyEval_RestoreThread(py_main_tstate);
+    py_main_tstate = NULL;
+#endif
+}
+
 void python_init(void)
 {
+    PY_STARTUP_REC *total, *step;
+
+    total = pystats_startup_begin("python_init");
+
+    py_frozen_init();
+
+    step = pystats_startup_begin("Py_InitializeEx");
     Py_InitializeEx(0);
+    pystats_startup_end(step);
 
+    step = pystats_startup_begin("py_threads_init");
+    py_threads_init();
+    pystats_startup_end(step);
+
+    step = pystats_startup_begin("pystats_init");
+    pystats_init();
+    pystats_startup_end(step);
+
+    step = pystats_startup_begin("pytimer_init");
+    pytimer_init();
+    pystats_startup_end(step);
+
+    step = pystats_startup_begin("pysignals_init");
     pysignals_init();
+    pystats_startup_end(step);
+
+    step = pystats_startup_begin("pystatusbar_init");
     pystatusbar_init();
-    if (!pyloader_init() || !pymodule_init() || !factory_init() || !pythemes_init()) 
+    pystats_startup_end(step);
+
+    if (!pystats_startup_call("pysource_init", pysource_init) || 
+            !pystats_startup_call("pyloader_init", pyloader_init) || 
+            !pystats_startup_call("pymodule_init", pymodule_init) || 
+            !pystats_startup_call("pyhost_init", pyhost_init) || 
+            !pystats_startup_call("factory_init", factory_init) || 
+            !pystats_startup_call("pythemes_init", pythemes_init)) 
     {
         printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, "Failed to load Python");
+        py_threads_start();
         return;
     }
+
+    step = pystats_startup_begin("pyconstants_init");
     pyconstants_init();
+    pystats_startup_end(step);
 
     /*PyImport_ImportModule("irssi_startup");*/
     /* Install the custom output handlers, import hook and reload function */
     /* XXX: handle import error */
+    step = pystats_startup_begin("import irssi_startup");
     PyRun_SimpleString(
             "import irssi_startup\n"
     );
+    pystats_startup_end(step);
 
+    step = pystats_startup_begin("pyloader_auto_load");
     pyloader_auto_load();
+    pystats_startup_end(step);
+
+    pystats_startup_end(total);
     
     /* assert(signal(SIGINT, intr_catch) != SIG_ERR); */
     
@@ -172,20 +523,36 @@ void python_init(void)
     command_bind("py unload", NULL, (SIGNAL_FUNC) cmd_unload);
     command_bind("py list", NULL, (SIGNAL_FUNC) cmd_list);
     command_bind("py exec", NULL, (SIGNAL_FUNC) cmd_exec);
+    command_bind("py stats", NULL, (SIGNAL_FUNC) cmd_stats);
+    command_bind("py resume", NULL, (SIGNAL_FUNC) cmd_resume);
+    command_bind("py startup", NULL, (SIGNAL_FUNC) cmd_startup);
+    command_bind("py host", NULL, (SIGNAL_FUNC) cmd_host);
     module_register(MODULE_NAME, "core");
+
+    py_threads_start();
 }
 
 void python_deinit(void)
 {
+    py_threads_deinit();
+
     command_unbind("py", (SIGNAL_FUNC) cmd_default);
     command_unbind("py load", (SIGNAL_FUNC) cmd_load);
     command_unbind("py unload", (SIGNAL_FUNC) cmd_unload);
     command_unbind("py list", (SIGNAL_FUNC) cmd_list);
     command_unbind("py exec", (SIGNAL_FUNC) cmd_exec);
+    command_unbind("py stats", (SIGNAL_FUNC) cmd_stats);
+    command_unbind("py resume", (SIGNAL_FUNC) cmd_resume);
+    command_unbind("py startup", (SIGNAL_FUNC) cmd_startup);
+    command_unbind("py host", (SIGNAL_FUNC) cmd_host);
 
+    pyhost_deinit();
     pymodule_deinit();
+    pysource_deinit();
     pyloader_deinit();
+    pytimer_deinit();
     pystatusbar_deinit();
     pysignals_deinit();
+    pystats_deinit();
     Py_Finalize();
 }
@@ -4,4 +4,10 @@
 void python_init(void);
 void python_deinit(void);
 
+/* Callbacks from irssi and GLib that run Python code hold the GIL between
+ * these. Calls nest, and the state from enter goes back to leave.
+ */
+int python_gil_enter(void);
+void python_gil_leave(int state);
+
 #endif
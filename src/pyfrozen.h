@@ -0,0 +1,10 @@
+#ifndef _PYFROZEN_H_
+#define _PYFROZEN_H_
+
+/* the wrappers_DATA modules of Makefile.am, compiled by freeze.py at build time */
+extern struct _frozen pyfrozen_modules[];
+
+/* PyImport_GetMagicNumber() of the Python that compiled them */
+extern const long pyfrozen_magic;
+
+#endif
@@ -0,0 +1,909 @@
+/* 
+    irssi-python
+
+    Copyright (C) 2006 Christopher Davis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <Python.h>
+#include <marshal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include "pyirssi.h"
+#include "pycore.h"
+#include "pyhost.h"
+#include "pyloader.h"
+#include "pymodule.h"
+#include "pysignals.h"
+#include "pyutils.h"
+#include "pyscript-object.h"
+
+/* NOTE:
+ * /py host runs a script in a forked helper process, so that a heavy or
+ * stuck script can't stall irssi and can use another core. irssi binds 
+ * the signals and commands the script asks for to a placeholder Script.
+ * Its handler turns the args into snapshots (dicts of the wrappers'
+ * attributes, since pointers mean nothing in the other process) and 
+ * writes them, marshalled, to a ring buffer in shared memory. When the 
+ * ring is full the event is dropped rather than waiting for the host.
+ *
+ * The host (irssi_host.py) reads the ring with _irssi._host_wait() and 
+ * sends commands, prints and binding changes back over a pipe with 
+ * _irssi._host_send(), one length prefixed marshalled tuple each.
+ */
+
+/* Single producer (irssi), single consumer (the host). head and tail are
+ * free running byte counts, records are a guint32 length and the data. 
+ */
+typedef struct
+{
+    volatile guint32 head; /* written by irssi */
+    volatile guint32 tail; /* written by the host */
+    volatile guint32 waiting; /* host is about to block on the notify pipe */
+    volatile guint32 dropped;
+    guint32 size; /* of data, a power of 2 */
+    char data[1];
+} PY_HOST_RING;
+
+#ifdef __GNUC__
+#define PY_HOST_BARRIER() __sync_synchronize()
+#else
+#define PY_HOST_BARRIER()
+#endif
+
+/* largest message the host may send */
+#define PY_HOST_MAX_MESSAGE (1024 * 1024)
+/* how deep wrappers inside wrappers are copied */
+#define PY_HOST_SNAPSHOT_DEPTH 2
+
+typedef struct
+{
+    char *name;
+    char *file;
+    int pid;
+    PY_HOST_RING *ring;
+    size_t ring_bytes; /* mapped */
+    int notify_fds[2]; /* wakes up the host */
+    int reply_fds[2]; /* messages from the host */
+    int reply_tag;
+    GString *reply_buf;
+    PyObject *script; /* holds the bindings made for the host */
+    unsigned long events;
+} PY_HOST_REC;
+
+static GSList *py_hosts;
+static PY_HOST_REC *py_host_self; /* set in the host process */
+
+static void py_ring_write(PY_HOST_RING *ring, guint32 pos, const void *src, guint32 len)
+{
+    guint32 off = pos & (ring->size - 1);
+    guint32 first = MIN(len, ring->size - off);
+
+    memcpy(ring->data + off, src, first);
+    memcpy(ring->data, (const char *)src + first, len - first);
+}
+
+static void py_ring_read(PY_HOST_RING *ring, guint32 pos, void *dest, guint32 len)
+{
+    guint32 off = pos & (ring->size - 1);
+    guint32 first = MIN(len, ring->size - off);
+
+    memcpy(dest, ring->data + off, first);
+    memcpy((char *)dest + first, ring->data, len - first);
+}
+
+static int py_ring_put(PY_HOST_REC *host, const char *data, guint32 len)
+{
+    PY_HOST_RING *ring = host->ring;
+    guint32 head = ring->head;
+
+    if (ring->size - (head - ring->tail) < len + 4)
+    {
+        ring->dropped++;
+        return 0;
+    }
+
+    py_ring_write(ring, head, &len, 4);
+    py_ring_write(ring, head + 4, data, len);
+    PY_HOST_BARRIER();
+    ring->head = head + 4 + len;
+    PY_HOST_BARRIER();
+
+    if (ring->waiting)
+    {
+        ring->waiting = 0;
+        if (write(host->notify_fds[1], "", 1) < 0 && errno != EAGAIN)
+            ring->waiting = 1;
+    }
+
+    host->events++;
+    return 1;
+}
+
+/* Append the events in the ring to list, in the host */
+static int py_ring_take(PY_HOST_RING *ring, PyObject *list)
+{
+    guint32 tail = ring->tail, head = ring->head;
+    int ret = 1;
+
+    PY_HOST_BARRIER();
+    while (tail != head && ret)
+    {
+        PyObject *buf, *event = NULL;
+        guint32 len;
+
+        py_ring_read(ring, tail, &len, 4);
+        buf = PyString_FromStringAndSize(NULL, len);
+        if (buf)
+        {
+            py_ring_read(ring, tail + 4, PyString_AS_STRING(buf), len);
+            event = PyMarshal_ReadObjectFromString(PyString_AS_STRING(buf), len);
+            Py_DECREF(buf);
+        }
+
+        if (!event || PyList_Append(list, event) != 0)
+            ret = 0;
+        Py_XDECREF(event);
+
+        tail += 4 + len;
+    }
+
+    PY_HOST_BARRIER();
+    ring->tail = tail;
+
+    return ret;
+}
+
+/* Copy of obj that only holds plain values. Wrapped irssi objects become
+ * dicts of their attributes, with the type name in '_type'.
+ */
+static PyObject *py_host_snapshot(PyObject *obj, int depth)
+{
+    PyObject *ret, *name;
+    PyTypeObject *type;
+    int i;
+
+    if (obj == Py_None || PyInt_Check(obj) || PyLong_Check(obj) || 
+            PyFloat_Check(obj) || PyString_Check(obj) || PyUnicode_Check(obj))
+    {
+        Py_INCREF(obj);
+        return obj;
+    }
+
+    if (PyList_Check(obj) || PyTuple_Check(obj))
+    {
+        Py_ssize_t len = PySequence_Fast_GET_SIZE(obj);
+
+        ret = PyList_New(len);
+        for (i = 0; ret && i < len; i++)
+        {
+            PyObject *item = py_host_snapshot(PySequence_Fast_GET_ITEM(obj, i), depth);
+            if (!item)
+            {
+                Py_CLEAR(ret);
+                break;
+            }
+            PyList_SET_ITEM(ret, i, item);
+        }
+
+        return ret;
+    }
+
+    if (depth <= 0 || !obj->ob_type->tp_getset)
+        Py_RETURN_NONE;
+
+    ret = PyDict_New();
+    if (!ret)
+        return NULL;
+
+    name = PyString_FromString(obj->ob_type->tp_name);
+    if (!name || PyDict_SetItemString(ret, "_type", name) != 0)
+    {
+        Py_XDECREF(name);
+        goto error;
+    }
+    Py_DECREF(name);
+
+    for (type = obj->ob_type; type != NULL; type = type->tp_base)
+    {
+        PyGetSetDef *def;
+
+        for (def = type->tp_getset; def && def->name; def++)
+        {
+            PyObject *attr, *value;
+
+            if (PyDict_GetItemString(ret, def->name))
+                continue;
+
+            /* dead objects and such raise, just leave those out */
+            attr = PyObject_GetAttrString(obj, def->name);
+            if (!attr)
+            {
+                PyErr_Clear();
+                continue;
+            }
+
+            value = py_host_snapshot(attr, depth - 1);
+            Py_DECREF(attr);
+            if (!value || PyDict_SetItemString(ret, def->name, value) != 0)
+            {
+                Py_XDECREF(value);
+                goto error;
+            }
+            Py_DECREF(value);
+        }
+    }
+
+    return ret;
+
+error:
+    Py_DECREF(ret);
+    return NULL;
+}
+
+/* Handler bound in irssi for the host. self is (host, kind, name). */
+static PyObject *py_host_event(PyObject *self, PyObject *args)
+{
+    PY_HOST_REC *host;
+    PyObject *snap, *event, *data;
+
+    host = PyCObject_AsVoidPtr(PyTuple_GET_ITEM(self, 0));
+
+    snap = py_host_snapshot(args, PY_HOST_SNAPSHOT_DEPTH);
+    if (!snap)
+        return NULL;
+
+    event = Py_BuildValue("(OON)", PyTuple_GET_ITEM(self, 1), 
+            PyTuple_GET_ITEM(self, 2), snap);
+    if (!event)
+        return NULL;
+
+    data = PyMarshal_WriteObjectToString(event, Py_MARSHAL_VERSION);
+    Py_DECREF(event);
+    if (!data)
+        return NULL;
+
+    py_ring_put(host, PyString_AS_STRING(data), PyString_GET_SIZE(data));
+    Py_DECREF(data);
+
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef py_host_event_def = {
+    "host_event", (PyCFunction)py_host_event, METH_VARARGS, NULL
+};
+
+static int py_host_bind(PY_HOST_REC *host, const char *kind, const char *name)
+{
+    PyScript *script = (PyScript *)host->script;
+    PyObject *self, *func;
+    int ret;
+
+    self = Py_BuildValue("(Nss)", PyCObject_FromVoidPtr(host, NULL), kind, name);
+    if (!self)
+        return 0;
+
+    func = PyCFunction_New(&py_host_event_def, self);
+    Py_DECREF(self);
+    if (!func)
+        return 0;
+
+    if (!strcmp(kind, "command"))
+        ret = pysignals_command_bind_table(&script->signals, name, func, 
+                NULL, SIGNAL_PRIORITY_DEFAULT, NULL);
+    else
+        ret = pysignals_signal_add_table(&script->signals, name, func, 
+                SIGNAL_PRIORITY_DEFAULT, 0, NULL);
+    Py_DECREF(func);
+
+    return ret;
+}
+
+static void py_host_unbind(PY_HOST_REC *host, const char *kind, const char *name)
+{
+    PyScript *script = (PyScript *)host->script;
+
+    if (script->signals)
+        pysignals_remove_search(script->signals, name, NULL, 
+                !strcmp(kind, "command")? PSG_COMMAND : PSG_SIGNAL);
+}
+
+/* Run a message from the host. Errors are printed. */
+static void py_host_message(PY_HOST_REC *host, PyObject *msg)
+{
+    char *kind, *name, *text, *tag = NULL, *target = NULL;
+    int level;
+    SERVER_REC *server = NULL;
+    WI_ITEM_REC *item = NULL;
+    int ok = 0;
+
+    if (!PyTuple_Check(msg) || PyTuple_GET_SIZE(msg) < 1 || 
+            !PyString_Check(PyTuple_GET_ITEM(msg, 0)))
+    {
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+                "%s: bad message from script host", host->name);
+        return;
+    }
+
+    kind = PyString_AS_STRING(PyTuple_GET_ITEM(msg, 0));
+
+    if (!strcmp(kind, "signal_add") || !strcmp(kind, "command_bind"))
+    {
+        if (PyArg_ParseTuple(msg, "ss", &kind, &name))
+            ok = py_host_bind(host, *kind == 's'? "signal" : "command", name);
+    }
+    else if (!strcmp(kind, "signal_remove") || !strcmp(kind, "command_unbind"))
+    {
+        if ((ok = PyArg_ParseTuple(msg, "ss", &kind, &name)))
+            py_host_unbind(host, *kind == 's'? "signal" : "command", name);
+    }
+    else if (!strcmp(kind, "command") || !strcmp(kind, "prnt"))
+    {
+        if (!strcmp(kind, "command"))
+            ok = PyArg_ParseTuple(msg, "ss|zz", &kind, &text, &tag, &target);
+        else
+            ok = PyArg_ParseTuple(msg, "ssi|zz", &kind, &text, &level, &tag, &target);
+
+        if (ok && tag)
+            server = server_find_tag(tag);
+        if (ok && server && target)
+            item = window_item_find(server, target);
+
+        if (ok && *kind == 'c')
+            py_command(text, server, item);
+        else if (ok)
+            printtext_string(server, target, level, text);
+    }
+    else
+    {
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+                "%s: unknown message %s from script host", host->name, kind);
+        return;
+    }
+
+    if (!ok)
+    {
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+                "%s: script host message %s failed", host->name, kind);
+        if (PyErr_Occurred())
+            PyErr_Print();
+    }
+}
+
+static PY_HOST_REC *py_host_find(const char *name)
+{
+    GSList *node;
+
+    for (node = py_hosts; node != NULL; node = node->next)
+    {
+        PY_HOST_REC *host = node->data;
+
+        if (!strcmp(host->name, name))
+            return host;
+    }
+
+    return NULL;
+}
+
+static void py_host_close_fds(PY_HOST_REC *host)
+{
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (host->notify_fds[i] != -1)
+            close(host->notify_fds[i]);
+        if (host->reply_fds[i] != -1)
+            close(host->reply_fds[i]);
+        host->notify_fds[i] = host->reply_fds[i] = -1;
+    }
+}
+
+static void py_host_destroy(PY_HOST_REC *host)
+{
+    py_hosts = g_slist_remove(py_hosts, host);
+
+    /* no more events after this */
+    if (host->script)
+    {
+        pyscript_cleanup(host->script);
+        Py_DECREF(host->script);
+    }
+
+    if (host->reply_tag != -1)
+        g_source_remove(host->reply_tag);
+
+    py_host_close_fds(host);
+
+    if (host->pid > 0)
+    {
+        kill(host->pid, SIGTERM);
+        pidwait_add(host->pid);
+    }
+
+    if (host->ring)
+        munmap(host->ring, host->ring_bytes);
+
+    g_string_free(host->reply_buf, TRUE);
+    g_free(host->name);
+    g_free(host->file);
+    g_free(host);
+}
+
+static int py_host_reply(PY_HOST_REC *host)
+{
+    PyObject *msgs;
+    GString *buf = host->reply_buf;
+    char data[4096];
+    int n, i;
+
+    n = read(host->reply_fds[0], data, sizeof(data));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+        return TRUE;
+
+    if (n <= 0)
+    {
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+                "%s: script host exited", host->name);
+        host->reply_tag = -1;
+        py_host_destroy(host);
+        return FALSE;
+    }
+
+    g_string_append_len(buf, data, n);
+
+    msgs = PyList_New(0);
+    if (!msgs)
+    {
+        PyErr_Print();
+        return TRUE;
+    }
+
+    while (buf->len >= 4)
+    {
+        PyObject *msg;
+        guint32 len;
+
+        memcpy(&len, buf->str, 4);
+        if (len > PY_HOST_MAX_MESSAGE)
+        {
+            printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+                    "%s: script host sent a bad message, stopping it", host->name);
+            Py_DECREF(msgs);
+            host->reply_tag = -1;
+            py_host_destroy(host);
+            return FALSE;
+        }
+
+        if (buf->len < 4 + len)
+            break;
+
+        msg = PyMarshal_ReadObjectFromString(buf->str + 4, len);
+        g_string_erase(buf, 0, 4 + len);
+
+        if (!msg || PyList_Append(msgs, msg) != 0)
+            PyErr_Print();
+        Py_XDECREF(msg);
+    }
+
+    /* a command from the host may stop it */
+    for (i = 0; i < PyList_GET_SIZE(msgs) && g_slist_find(py_hosts, host); i++)
+        py_host_message(host, PyList_GET_ITEM(msgs, i));
+
+    Py_DECREF(msgs);
+    return TRUE;
+}
+
+static int py_host_reply_proxy(GIOChannel *src, GIOCondition condition, PY_HOST_REC *host)
+{
+    int gil, ret;
+
+    gil = python_gil_enter();
+    ret = py_host_reply(host);
+    python_gil_leave(gil);
+
+    return ret;
+}
+
+/* Runs in the forked process and never returns */
+static void py_host_child(PY_HOST_REC *host, char **argv)
+{
+    PyObject *module, *args, *ret = NULL;
+    int fd, i, max;
+
+    PyOS_AfterFork();
+    py_host_self = host;
+
+    /* Drop everything inherited from irssi (server sockets, DCC and log
+       files, other hosts' pipes), or closing them in irssi wouldn't 
+       really close them while this host runs. */
+    max = sysconf(_SC_OPEN_MAX);
+    if (max < 0)
+        max = 1024;
+    for (fd = 3; fd < max; fd++)
+    {
+        if (fd != host->notify_fds[0] && fd != host->reply_fds[1])
+            close(fd);
+    }
+    host->notify_fds[1] = host->reply_fds[0] = -1;
+
+    /* the terminal belongs to irssi */
+    fd = open("/dev/null", O_RDWR);
+    if (fd >= 0)
+    {
+        dup2(fd, 0);
+        dup2(fd, 1);
+        dup2(fd, 2);
+        if (fd > 2)
+            close(fd);
+    }
+
+    signal(SIGINT, SIG_IGN);
+    signal(SIGHUP, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    module = PyImport_ImportModule("irssi_host");
+    args = PyList_New(0);
+    for (i = 1; args && argv[i]; i++)
+    {
+        PyObject *arg = PyString_FromString(argv[i]);
+        if (!arg || PyList_Append(args, arg) != 0)
+            Py_CLEAR(args);
+        Py_XDECREF(arg);
+    }
+
+    if (module && args)
+        ret = PyObject_CallMethod(module, "run", "ssO", host->name, host->file, args);
+
+    /* irssi_host reports its own errors over the pipe */
+    if (!ret)
+        PyErr_Clear();
+
+    _exit(ret? 0 : 1);
+}
+
+static char *py_host_name(const char *arg)
+{
+    char *name = g_path_get_basename(arg);
+    char *ext = strrchr(name, '.');
+
+    if (ext && !strcmp(ext, ".py"))
+        *ext = '\0';
+
+    return name;
+}
+
+/* argv[0] is the script name or file, the rest go to the script */
+int pyhost_start(char **argv)
+{
+    PY_HOST_REC *host;
+    PyObject *module;
+    GIOChannel *channel;
+    size_t size;
+    int i;
+
+    g_return_val_if_fail(argv != NULL && argv[0] != NULL, 0);
+
+    host = g_new0(PY_HOST_REC, 1);
+    host->name = py_host_name(argv[0]);
+    host->reply_tag = -1;
+    host->reply_buf = g_string_new(NULL);
+    for (i = 0; i < 2; i++)
+        host->notify_fds[i] = host->reply_fds[i] = -1;
+
+    if (py_host_find(host->name) || pyloader_find_script(host->name))
+    {
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+                "script %s is already loaded", host->name);
+        goto error;
+    }
+
+    host->file = pyloader_find_script_path(argv[0]);
+    if (!host->file)
+    {
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+                "script %s does not exist", argv[0]);
+        goto error;
+    }
+
+    for (size = 4096; size < (size_t)settings_get_int("python_host_ring_size") * 1024; )
+        size <<= 1;
+
+    host->ring_bytes = sizeof(PY_HOST_RING) + size;
+    host->ring = mmap(NULL, host->ring_bytes, PROT_READ | PROT_WRITE, 
+            MAP_SHARED | MAP_ANON, -1, 0);
+    if (host->ring == MAP_FAILED)
+    {
+        host->ring = NULL;
+        goto error_errno;
+    }
+    host->ring->size = size;
+
+    if (pipe(host->notify_fds) != 0 || pipe(host->reply_fds) != 0)
+        goto error_errno;
+
+    /* irssi never waits on the host */
+    fcntl(host->notify_fds[1], F_SETFL, O_NONBLOCK);
+    fcntl(host->reply_fds[0], F_SETFL, O_NONBLOCK);
+
+    module = PyModule_New(host->name);
+    if (module)
+    {
+        host->script = pyscript_new(module, argv);
+        Py_DECREF(module);
+    }
+    if (!host->script)
+    {
+        PyErr_Print();
+        goto error;
+    }
+
+    host->pid = fork();
+    if (host->pid < 0)
+        goto error_errno;
+    if (host->pid == 0)
+        py_host_child(host, argv);
+
+    close(host->notify_fds[0]);
+    close(host->reply_fds[1]);
+    host->notify_fds[0] = host->reply_fds[1] = -1;
+
+    channel = g_io_channel_unix_new(host->reply_fds[0]);
+    host->reply_tag = g_io_add_watch(channel, G_IO_IN | G_IO_HUP | G_IO_ERR, 
+            (GIOFunc)py_host_reply_proxy, host);
+    g_io_channel_unref(channel);
+
+    py_hosts = g_slist_append(py_hosts, host);
+    printtext(NULL, NULL, MSGLEVEL_CLIENTNOTICE, 
+            "loaded script %s in process %d", host->name, host->pid);
+
+    return 1;
+
+error_errno:
+    printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+            "failed to start a host for %s: %s", host->name, g_strerror(errno));
+error:
+    host->pid = 0;
+    py_host_destroy(host);
+    return 0;
+}
+
+int pyhost_stop(const char *name)
+{
+    PY_HOST_REC *host = py_host_find(name);
+
+    if (!host)
+        return 0;
+
+    py_host_destroy(host);
+    printtext(NULL, NULL, MSGLEVEL_CLIENTNOTICE, "unloaded script %s", name); 
+
+    return 1;
+}
+
+GSList *pyhost_list(void)
+{
+    GSList *list = NULL, *node;
+
+    for (node = py_hosts; node != NULL; node = node->next)
+    {
+        PY_HOST_REC *host = node->data;
+        PY_HOST_LIST_REC *rec = g_new0(PY_HOST_LIST_REC, 1);
+
+        rec->name = g_strdup(host->name);
+        rec->file = g_strdup(host->file);
+        rec->pid = host->pid;
+        rec->events = host->events;
+        rec->dropped = host->ring->dropped;
+
+        list = g_slist_append(list, rec);
+    }
+
+    return list;
+}
+
+void pyhost_list_destroy(GSList **list)
+{
+    GSList *node;
+
+    for (node = *list; node != NULL; node = node->next)
+    {
+        PY_HOST_LIST_REC *rec = node->data;
+
+        g_free(rec->name);
+        g_free(rec->file);
+        g_free(rec);
+    }
+
+    g_slist_free(*list);
+    *list = NULL;
+}
+
+PyDoc_STRVAR(py_host_wait_doc,
+    "_host_wait(timeout=-1) -> list of events or None\n"
+    "\n"
+    "Script host only. Wait up to timeout seconds (forever if negative)\n"
+    "for events from irssi. Returns None once irssi has gone away.\n"
+);
+static PyObject *py_host_wait(PyObject *self, PyObject *args)
+{
+    PyObject *events;
+    PY_HOST_RING *ring;
+    double timeout = -1;
+    int fd, done = FALSE;
+
+    if (!PyArg_ParseTuple(args, "|d", &timeout))
+        return NULL;
+
+    if (!py_host_self)
+        return PyErr_Format(PyExc_RuntimeError, "not in a script host");
+
+    ring = py_host_self->ring;
+    fd = py_host_self->notify_fds[0];
+
+    events = PyList_New(0);
+    if (!events)
+        return NULL;
+
+    for (;;)
+    {
+        struct timeval tv, *tvp = NULL;
+        fd_set fds;
+        char buf[64];
+        int n;
+
+        if (!py_ring_take(ring, events))
+            goto error;
+        if (PyList_GET_SIZE(events) > 0 || done)
+            return events;
+
+        /* py_ring_put wakes us up only when this is set */
+        ring->waiting = 1;
+        PY_HOST_BARRIER();
+        if (ring->head != ring->tail)
+        {
+            ring->waiting = 0;
+            continue;
+        }
+
+        if (timeout >= 0)
+        {
+            tv.tv_sec = (long)timeout;
+            tv.tv_usec = (long)((timeout - tv.tv_sec) * 1e6);
+            tvp = &tv;
+        }
+
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
+
+        Py_BEGIN_ALLOW_THREADS
+        n = select(fd + 1, &fds, NULL, NULL, tvp);
+        Py_END_ALLOW_THREADS
+
+        ring->waiting = 0;
+
+        if (n < 0 && errno != EINTR)
+        {
+            PyErr_SetFromErrno(PyExc_OSError);
+            goto error;
+        }
+
+        if (n == 0)
+            done = TRUE;
+        else if (n > 0 && read(fd, buf, sizeof(buf)) == 0)
+        {
+            Py_DECREF(events);
+            Py_RETURN_NONE;
+        }
+    }
+
+error:
+    Py_DECREF(events);
+    return NULL;
+}
+
+PyDoc_STRVAR(py_host_send_doc,
+    "_host_send(msg) -> None\n"
+    "\n"
+    "Script host only. Send a message tuple to irssi.\n"
+);
+static PyObject *py_host_send(PyObject *self, PyObject *args)
+{
+    PyObject *msg, *data;
+    char *buf, *p;
+    guint32 len, left;
+    int fd, n = 0;
+
+    if (!PyArg_ParseTuple(args, "O!", &PyTuple_Type, &msg))
+        return NULL;
+
+    if (!py_host_self)
+        return PyErr_Format(PyExc_RuntimeError, "not in a script host");
+
+    fd = py_host_self->reply_fds[1];
+
+    data = PyMarshal_WriteObjectToString(msg, Py_MARSHAL_VERSION);
+    if (!data)
+        return NULL;
+
+    len = PyString_GET_SIZE(data);
+    if (len > PY_HOST_MAX_MESSAGE)
+    {
+        Py_DECREF(data);
+        return PyErr_Format(PyExc_ValueError, "message too long");
+    }
+
+    /* prefix and payload go out together, so a short or interrupted
+       write can't leave the stream without its framing */
+    buf = g_malloc(4 + len);
+    memcpy(buf, &len, 4);
+    memcpy(buf + 4, PyString_AS_STRING(data), len);
+    Py_DECREF(data);
+
+    Py_BEGIN_ALLOW_THREADS
+    for (p = buf, left = 4 + len; left > 0; p += n, left -= n)
+    {
+        n = write(fd, p, left);
+        if (n < 0 && errno == EINTR)
+            n = 0;
+        else if (n < 0)
+            break;
+    }
+    Py_END_ALLOW_THREADS
+
+    g_free(buf);
+
+    if (n < 0)
+        return PyErr_SetFromErrno(PyExc_IOError);
+
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef py_host_methods[] = {
+    {"_host_wait", (PyCFunction)py_host_wait, METH_VARARGS, 
+        py_host_wait_doc},
+    {"_host_send", (PyCFunction)py_host_send, METH_VARARGS, 
+        py_host_send_doc},
+    {NULL}  /* Sentinel */
+};
+
+int pyhost_init(void)
+{
+    PyMethodDef *def;
+
+    settings_add_int("python", "python_host_ring_size", 1024);
+
+    for (def = py_host_methods; def->ml_name; def++)
+    {
+        PyObject *func = PyCFunction_New(def, NULL);
+
+        if (!func || PyModule_AddObject(py_module, def->ml_name, func) != 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+void pyhost_deinit(void)
+{
+    while (py_hosts)
+        py_host_destroy(py_hosts->data);
+}
@@ -0,0 +1,24 @@
+#ifndef _PYHOST_H_
+#define _PYHOST_H_
+
+#include <glib.h>
+
+/* A script running in a helper process, see pyhost.c */
+typedef struct
+{
+    char *name;
+    char *file;
+    int pid;
+    unsigned long events; /* sent to the host */
+    unsigned long dropped; /* lost because the ring was full */
+} PY_HOST_LIST_REC;
+
+int pyhost_start(char **argv);
+int pyhost_stop(const char *name);
+GSList *pyhost_list(void);
+void pyhost_list_destroy(GSList **list);
+
+int pyhost_init(void);
+void pyhost_deinit(void);
+
+#endif
@@ -20,21 +20,83 @@
 
 #include <Python.h>
 #include <frameobject.h>
+#include <marshal.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "pyirssi.h"
+#include "pycore.h"
 #include "pyloader.h"
 #include "pyutils.h"
+#include "pystats.h"
 #include "pyscript-object.h"
 
-/* List of loaded modules */
+#if PY_VERSION_HEX < 0x02050000
+typedef int Py_ssize_t;
+#endif
+
+/* NOTE:
+ * Compiled scripts are cached in ~/.irssi/pycache, one file per script path
+ * named after a hash of the path. A cache file starts with a PY_CODE_HEADER
+ * and the source path, followed by the marshalled code object. A file 
+ * whose header or path doesn't match the script is ignored and rewritten,
+ * so a changed script, a different Python or a hash collision only costs a
+ * compile. Set python_bytecode_cache off to always compile.
+ */
+typedef struct
+{
+    long magic; /* PyImport_GetMagicNumber() */
+    long mtime; /* of the source */
+    long size;
+    long pathlen;
+} PY_CODE_HEADER;
+
+/* NOTE:
+ * A script in autorun/ may declare its bindings in the comment block at
+ * the top of the file, before the first line of code:
+ *
+ *     # autoload: command wordcount
+ *     # autoload: signal message public
+ *
+ * Such a script isn't run at startup. The loader binds a stub for each
+ * entry instead, and the first time any of them fires the stubs are
+ * removed and the script is loaded. The stubs are bound at
+ * PY_AUTOLOAD_PRIORITY, ahead of any handler a script would normally use,
+ * so the handlers the script binds while loading are still reached by the
+ * emit that triggered it. Later emits go straight to the script.
+ */
+#define PY_AUTOLOAD_PRIORITY (SIGNAL_PRIORITY_HIGH - 100)
+#define PY_AUTOLOAD_TAG "autoload:"
+
+typedef struct
+{
+    char *name;
+    char *path;
+    GSList *commands;
+    GSList *signals;
+} PY_AUTOLOAD_REC;
+
+/* Dict of loaded scripts, name -> script */
 static PyObject *script_modules;
+static unsigned long script_seq = 0;
+
+/* Script whose code is running on the main thread, see 
+   pyloader_enter_script */
+static PyObject *py_current_script = NULL;
+static PyThreadState *py_main_thread = NULL;
+
+/* Autorun scripts waiting for one of their bindings to fire */
+static GSList *autoload_scripts = NULL;
 
 /* List of load paths for scripts */
 static GSList *script_paths = NULL;
 
-static PyObject *py_get_script(const char *name, int *id);
-static int py_load_module(PyObject *module, const char *path);
+static PyObject *py_get_script(const char *name);
+static int py_load_module(PyObject *module, const char *path, int *cached);
 static char *py_find_script(const char *name);
+static int py_load_script_path(const char *path);
 
 /* Add to the list of script load paths */
 void pyloader_add_script_path(const char *path)
@@ -47,10 +109,148 @@ void pyloader_add_script_path(const char *path)
     }
 }
 
+static char *py_cache_path(const char *path)
+{
+    return g_strdup_printf("%s/pycache/%08x.pyc", get_irssi_dir(), 
+            g_str_hash(path));
+}
+
+static void py_cache_header(PY_CODE_HEADER *hdr, const char *path, struct stat *st)
+{
+    memset(hdr, 0, sizeof *hdr);
+    hdr->magic = PyImport_GetMagicNumber();
+    hdr->mtime = st->st_mtime;
+    hdr->size = st->st_size;
+    hdr->pathlen = strlen(path);
+}
+
+/* returns new reference to the cached code, or NULL without an exception */
+static PyObject *py_cache_read(const char *path, struct stat *st)
+{
+    PY_CODE_HEADER hdr, want;
+    PyObject *code = NULL;
+    char *cpath, *buf = NULL;
+    gsize len;
+
+    cpath = py_cache_path(path);
+    if (!g_file_get_contents(cpath, &buf, &len, NULL))
+        goto done;
+
+    py_cache_header(&want, path, st);
+    if (len < sizeof hdr + want.pathlen)
+        goto done;
+
+    memcpy(&hdr, buf, sizeof hdr);
+    if (memcmp(&hdr, &want, sizeof hdr) != 0 || 
+            memcmp(buf + sizeof hdr, path, hdr.pathlen) != 0)
+        goto done;
+
+    code = PyMarshal_ReadObjectFromString(buf + sizeof hdr + hdr.pathlen, 
+            len - sizeof hdr - hdr.pathlen);
+    if (!code || !PyCode_Check(code))
+    {
+        PyErr_Clear();
+        Py_XDECREF(code);
+        code = NULL;
+    }
+
+done:
+    g_free(buf);
+    g_free(cpath);
+    return code;
+}
+
+/* Failing to write the cache is not an error; the script still loads */
+static void py_cache_write(const char *path, struct stat *st, PyObject *code)
+{
+    PY_CODE_HEADER hdr;
+    PyObject *data;
+    char *cpath, *tmp, *dir;
+    int fd, ok;
+
+    data = PyMarshal_WriteObjectToString(code, Py_MARSHAL_VERSION);
+    if (!data)
+    {
+        PyErr_Clear();
+        return;
+    }
+
+    dir = g_strdup_printf("%s/pycache", get_irssi_dir());
+    mkdir(dir, 0700);
+    g_free(dir);
+
+    cpath = py_cache_path(path);
+    tmp = g_strdup_printf("%s.%d", cpath, (int)getpid());
+    
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd >= 0)
+    {
+        py_cache_header(&hdr, path, st);
+        ok = write(fd, &hdr, sizeof hdr) == sizeof hdr &&
+            write(fd, path, hdr.pathlen) == hdr.pathlen &&
+            write(fd, PyString_AS_STRING(data), PyString_GET_SIZE(data)) 
+                == PyString_GET_SIZE(data);
+        ok = close(fd) == 0 && ok;
+
+        /* readers only ever see a complete file */
+        if (!ok || rename(tmp, cpath) != 0)
+            unlink(tmp);
+    }
+
+    g_free(tmp);
+    g_free(cpath);
+    Py_DECREF(data);
+}
+
+/* returns new reference to the code object for path */
+static PyObject *py_compile_file(const char *path, int *cached)
+{
+    PyObject *code;
+    struct stat st;
+    char *src;
+    gsize len;
+    int use_cache;
+
+    *cached = FALSE;
+
+    if (stat(path, &st) != 0)
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char *)path);
+
+    use_cache = settings_get_bool("python_bytecode_cache");
+    if (use_cache)
+    {
+        code = py_cache_read(path, &st);
+        if (code)
+        {
+            *cached = TRUE;
+            return code;
+        }
+    }
+
+    if (!g_file_get_contents(path, &src, &len, NULL))
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char *)path);
+
+    /* older compilers reject source without a final newline */
+    if (len > 0 && src[len - 1] != '\n')
+    {
+        char *tmp = g_strconcat(src, "\n", NULL);
+        g_free(src);
+        src = tmp;
+    }
+
+    code = Py_CompileString(src, path, Py_file_input);
+    g_free(src);
+
+    if (code && use_cache)
+        py_cache_write(path, &st, code);
+
+    return code;
+}
+
 /* Loads a file into a module; it is not inserted into sys.modules */
-static int py_load_module(PyObject *module, const char *path) 
+static int py_load_module(PyObject *module, const char *path, int *cached) 
 {
-    PyObject *dict, *ret, *fp;
+    PyObject *dict, *ret, *code;
 
     if (PyModule_AddStringConstant(module, "__file__", (char *)path) < 0)
         return 0;
@@ -60,14 +260,12 @@ static int py_load_module(PyObject *module, const char *path)
     if (PyDict_SetItemString(dict, "__builtins__", PyEval_GetBuiltins()) < 0)
         return 0;
 
-    /* Dont use the standard library to avoid incompatabilities with 
-       the FILE structure and Python */
-    fp = PyFile_FromString((char *)path, "r");
-    if (!fp)
+    code = py_compile_file(path, cached);
+    if (!code)
         return 0;
 
-    ret = PyRun_File(PyFile_AsFile(fp), path, Py_file_input, dict, dict);
-    Py_DECREF(fp);  /* XXX: I assume that the file is closed when refs drop to zero? */ 
+    ret = PyEval_EvalCode((PyCodeObject *)code, dict, dict);
+    Py_DECREF(code);
     if (!ret)
         return 0;
 
@@ -108,6 +306,194 @@ static char *py_find_script(const char *name)
     return path;
 }
 
+static void py_autoload_stub(void);
+
+static PY_AUTOLOAD_REC *py_autoload_find(const char *name)
+{
+    GSList *node;
+
+    for (node = autoload_scripts; node != NULL; node = node->next)
+    {
+        PY_AUTOLOAD_REC *rec = node->data;
+
+        if (!strcmp(rec->name, name))
+            return rec;
+    }
+
+    return NULL;
+}
+
+static void py_autoload_destroy(PY_AUTOLOAD_REC *rec)
+{
+    GSList *node;
+
+    for (node = rec->commands; node != NULL; node = node->next)
+        g_free(node->data);
+    g_slist_free(rec->commands);
+
+    for (node = rec->signals; node != NULL; node = node->next)
+        g_free(node->data);
+    g_slist_free(rec->signals);
+
+    g_free(rec->name);
+    g_free(rec->path);
+    g_free(rec);
+}
+
+static void py_autoload_unbind(PY_AUTOLOAD_REC *rec)
+{
+    GSList *node;
+
+    for (node = rec->commands; node != NULL; node = node->next)
+        command_unbind_full(node->data, (SIGNAL_FUNC)py_autoload_stub, rec);
+
+    for (node = rec->signals; node != NULL; node = node->next)
+        signal_remove_full(node->data, (SIGNAL_FUNC)py_autoload_stub, rec);
+
+    autoload_scripts = g_slist_remove(autoload_scripts, rec);
+}
+
+/* Drop the stubs of a pending autorun script. Returns 1 if it was pending */
+static int py_autoload_cancel(const char *name)
+{
+    PY_AUTOLOAD_REC *rec = py_autoload_find(name);
+
+    if (!rec)
+        return 0;
+
+    py_autoload_unbind(rec);
+    py_autoload_destroy(rec);
+    return 1;
+}
+
+/* Stub for every declared command and signal; the arguments are ignored */
+static void py_autoload_stub(void)
+{
+    PY_AUTOLOAD_REC *rec = signal_get_user_data();
+    char *path;
+    int gil;
+
+    g_return_if_fail(rec != NULL);
+
+    path = g_strdup(rec->path);
+    py_autoload_unbind(rec);
+    py_autoload_destroy(rec);
+
+    gil = python_gil_enter();
+    py_load_script_path(path);
+    python_gil_leave(gil);
+    g_free(path);
+}
+
+/* Read the declared bindings from the header of an autorun script.
+ * Returns NULL if the script has none or the header is malformed, in which
+ * case it should be loaded right away.
+ */
+static PY_AUTOLOAD_REC *py_autoload_parse(const char *path)
+{
+    PY_AUTOLOAD_REC *rec;
+    char line[512];
+    FILE *fp;
+    int lineno = 0, ok = 1;
+
+    fp = fopen(path, "r");
+    if (!fp)
+        return NULL;
+
+    rec = g_new0(PY_AUTOLOAD_REC, 1);
+
+    while (ok && fgets(line, sizeof line, fp))
+    {
+        char *p = line, *arg;
+
+        lineno++;
+        g_strstrip(p);
+        if (*p == '\0')
+            continue;
+        if (*p != '#')
+            break;
+
+        for (p++; *p == ' ' || *p == '\t'; p++)
+            ;
+        if (strncmp(p, PY_AUTOLOAD_TAG, strlen(PY_AUTOLOAD_TAG)) != 0)
+            continue;
+
+        p += strlen(PY_AUTOLOAD_TAG);
+        while (*p == ' ' || *p == '\t')
+            p++;
+
+        arg = strpbrk(p, " \t");
+        if (arg)
+        {
+            *arg++ = '\0';
+            g_strstrip(arg);
+        }
+
+        if (!arg || *arg == '\0')
+            ok = 0;
+        else if (!strcmp(p, "command"))
+            rec->commands = g_slist_append(rec->commands, g_strdup(arg));
+        else if (!strcmp(p, "signal"))
+            rec->signals = g_slist_append(rec->signals, g_strdup(arg));
+        else
+            ok = 0;
+    }
+
+    fclose(fp);
+
+    if (!ok)
+    {
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+                "%s:%d: bad autoload line, loading the script now", path, lineno); 
+    }
+
+    if (!ok || (!rec->commands && !rec->signals))
+    {
+        py_autoload_destroy(rec);
+        return NULL;
+    }
+
+    rec->name = file_get_filename(path);
+    rec->path = g_strdup(path);
+
+    return rec;
+}
+
+/* Bind the stubs for a script, or load it if it declares nothing */
+static void py_autoload_script(const char *path)
+{
+    PY_AUTOLOAD_REC *rec;
+    GSList *node;
+
+    rec = py_autoload_parse(path);
+    if (!rec)
+    {
+        py_load_script_path(path);
+        return;
+    }
+
+    /* a script of the same name earlier in the path wins */
+    if (py_autoload_find(rec->name) || py_get_script(rec->name))
+    {
+        py_autoload_destroy(rec);
+        return;
+    }
+
+    for (node = rec->commands; node != NULL; node = node->next)
+    {
+        command_bind_full(MODULE_NAME, PY_AUTOLOAD_PRIORITY, node->data, 
+                -1, NULL, (SIGNAL_FUNC)py_autoload_stub, rec);
+    }
+
+    for (node = rec->signals; node != NULL; node = node->next)
+    {
+        signal_add_full(MODULE_NAME, PY_AUTOLOAD_PRIORITY, node->data,
+                (SIGNAL_FUNC)py_autoload_stub, rec);
+    }
+
+    autoload_scripts = g_slist_append(autoload_scripts, rec);
+}
+
 /* Load a script manually using PyRun_File.
  * This expects a null terminated array of strings 
  * (such as from g_strsplit) of the command line.
@@ -115,9 +501,14 @@ static char *py_find_script(const char *name)
  */
 static int py_load_script_path_argv(const char *path, char **argv)
 {
-    PyObject *module = NULL, *script = NULL;
+    PyObject *module = NULL, *script = NULL, *prev;
     char *name = NULL; 
+    double start;
+    int cached, ok;
+
+    py_autoload_cancel(argv[0]);
 
+    start = pystats_now();
     name = file_get_filename(path);
     module = PyModule_New(name);
     g_free(name);
@@ -135,10 +526,17 @@ static int py_load_script_path_argv(const char *path, char **argv)
 
     Py_INCREF(script);
     
-    if (!py_load_module(module, path))
+    prev = pyloader_enter_script(script);
+    ok = py_load_module(module, path, &cached);
+    pyloader_leave_script(prev);
+    if (!ok)
         goto error;
+
+    ((PyScript *)script)->load_time = pystats_now() - start;
+    ((PyScript *)script)->load_cached = cached;
+    ((PyScript *)script)->load_seq = script_seq++;
     
-    if (PyList_Append(script_modules, script) != 0)
+    if (PyDict_SetItemString(script_modules, pyscript_get_name(script), script) != 0)
         goto error;
 
     printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, "loaded script %s", argv[0]); 
@@ -173,7 +571,7 @@ static int py_load_script_path(const char *path)
     argv[0] = file_get_filename(path);
     argv[1] = NULL;
 
-    if (py_get_script(argv[0], NULL) != NULL)
+    if (py_get_script(argv[0]) != NULL)
         pyloader_unload_script(argv[0]);
 
     ret = py_load_script_path_argv(path, argv);
@@ -187,7 +585,7 @@ int pyloader_load_script_argv(char **argv)
     char *path;
     int ret;
 
-    if (py_get_script(argv[0], NULL) != NULL)
+    if (py_get_script(argv[0]) != NULL)
         pyloader_unload_script(argv[0]);
    
     path = py_find_script(argv[0]);
@@ -213,35 +611,22 @@ int pyloader_load_script(char *name)
     return pyloader_load_script_argv(argv);
 }
 
-static PyObject *py_get_script(const char *name, int *id)
+static PyObject *py_get_script(const char *name)
 {
-    int i;
-
     g_return_val_if_fail(script_modules != NULL, NULL);
     
-    for (i = 0; i < PyList_Size(script_modules); i++)
-    {
-        PyObject *script;
-        char *sname;
-
-        script = PyList_GET_ITEM(script_modules, i);
-        sname = pyscript_get_name(script);
-
-        if (sname && !strcmp(sname, name))
-        {
-            if (id)
-                *id = i;
-            return script;
-        }
-    }
-
-    return NULL;
+    return PyDict_GetItemString(script_modules, (char *)name);
 }
 
 int pyloader_unload_script(const char *name)
 {
-    int id;
-    PyObject *script = py_get_script(name, &id);
+    PyObject *script = py_get_script(name);
+
+    if (!script && py_autoload_cancel(name))
+    {
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, "unloaded script %s", name); 
+        return 1;
+    }
 
     if (!script)
     {
@@ -253,7 +638,7 @@ int pyloader_unload_script(const char *name)
     
     pyscript_cleanup(script);
 
-    if (PySequence_DelItem(script_modules, id) < 0)
+    if (PyDict_DelItemString(script_modules, (char *)name) < 0)
     {
         PyErr_Print();
         printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, "error unloading script %s", name); 
@@ -267,11 +652,55 @@ int pyloader_unload_script(const char *name)
     return 1; 
 }
 
-/* Traverse stack backwards to find the nearest valid _script object in globals */
+/* returns full path of script name, to be freed, or NULL if not found */
+char *pyloader_find_script_path(const char *name)
+{
+    if (g_path_is_absolute(name))
+        return g_file_test(name, G_FILE_TEST_IS_REGULAR)? g_strdup(name) : NULL;
+
+    return py_find_script(name);
+}
+
+/* returns borrowed reference to loaded script, or NULL */
+PyObject *pyloader_find_script(const char *name)
+{
+    return py_get_script(name);
+}
+
+/* Mark script as the one running until pyloader_leave_script is called 
+ * with the returned value. Proxies wrap each handler call with these, so 
+ * API calls made by the handler find the script without walking the stack.
+ * The script is kept alive meanwhile, in case the handler unloads it.
+ */
+PyObject *pyloader_enter_script(PyObject *script)
+{
+    PyObject *prev = py_current_script;
+
+    Py_XINCREF(script);
+    py_current_script = script;
+
+    return prev;
+}
+
+void pyloader_leave_script(PyObject *prev)
+{
+    PyObject *script = py_current_script;
+
+    py_current_script = prev;
+    Py_XDECREF(script);
+}
+
+/* Return the running script, or traverse stack backwards to find the 
+ * nearest valid _script object in globals. Other threads always walk the
+ * stack, since the running script is only tracked for the main thread.
+ */
 PyObject *pyloader_find_script_obj(void)
 {
     PyFrameObject *frame;
 
+    if (py_current_script && PyThreadState_GET() == py_main_thread)
+        return py_current_script;
+
     for (frame = PyEval_GetFrame(); frame != NULL; frame = frame->f_back)
     {
         PyObject *script;
@@ -303,19 +732,29 @@ char *pyloader_find_script_name(void)
     return pyscript_get_name(script);
 }
 
+static int py_script_cmp(PyScript *a, PyScript *b)
+{
+    return a->load_seq < b->load_seq? -1 : a->load_seq > b->load_seq;
+}
+
 GSList *pyloader_list(void)
 {
-    int i;
-    GSList *list = NULL;
+    GSList *list = NULL, *scripts = NULL, *node;
+    PyObject *key, *scr;
+    Py_ssize_t pos = 0;
 
     g_return_val_if_fail(script_modules != NULL, NULL);
 
-    for (i = 0; i < PyList_Size(script_modules); i++)
+    /* in load order */
+    while (PyDict_Next(script_modules, &pos, &key, &scr))
+        scripts = g_slist_prepend(scripts, scr);
+    scripts = g_slist_sort(scripts, (GCompareFunc)py_script_cmp);
+
+    for (node = scripts; node != NULL; node = node->next)
     {
-        PyObject *scr;
         char *name, *file;
 
-        scr = PyList_GET_ITEM(script_modules, i);
+        scr = node->data;
         name = pyscript_get_name(scr);
         file = pyscript_get_filename(scr);
 
@@ -326,9 +765,25 @@ GSList *pyloader_list(void)
 
             rec->name = g_strdup(name);
             rec->file = g_strdup(file);
+            rec->load_time = ((PyScript *)scr)->load_time;
+            rec->load_cached = ((PyScript *)scr)->load_cached;
+            rec->timers = g_list_length(((PyScript *)scr)->timers);
             list = g_slist_append(list, rec); 
         }
     }
+    g_slist_free(scripts);
+
+    for (node = autoload_scripts; node != NULL; node = node->next)
+    {
+        PY_AUTOLOAD_REC *arec = node->data;
+        PY_LIST_REC *rec;
+
+        rec = g_new0(PY_LIST_REC, 1);
+        rec->name = g_strdup(arec->name);
+        rec->file = g_strdup(arec->path);
+        rec->pending = 1;
+        list = g_slist_append(list, rec); 
+    }
 
     return list;
 }
@@ -375,7 +830,11 @@ void pyloader_auto_load(void)
             char *path = g_strdup_printf("%s/autorun/%s", (char*)node->data, name);
 
             if (!strcmp(file_get_ext(name), "py"))
-                py_load_script_path(path);
+            {
+                PY_STARTUP_REC *step = pystats_startup_begin(name);
+                py_autoload_script(path);
+                pystats_startup_end(step);
+            }
 
             g_free(path);
         }
@@ -391,9 +850,11 @@ int pyloader_init(void)
     g_return_val_if_fail(script_paths == NULL, 0);
     g_return_val_if_fail(script_modules == NULL, 0);
 
-    script_modules = PyList_New(0);
+    script_modules = PyDict_New();
     if (!script_modules)
         return 0;
+
+    py_main_thread = PyThreadState_GET();
     
     /* Add script location to the load path */
     pyhome = g_strdup_printf("%s/scripts", get_irssi_dir());
@@ -402,19 +863,19 @@ int pyloader_init(void)
    
     /* typically /usr/local/share/irssi/scripts */
     pyloader_add_script_path(SCRIPTDIR);
+
+    settings_add_bool("python", "python_bytecode_cache", TRUE);
    
     return 1;
 }
 
 static void py_clear_scripts()
 {
-    int i;
+    PyObject *key, *scr;
+    Py_ssize_t pos = 0;
     
-    for (i = 0; i < PyList_Size(script_modules); i++)
-    {
-        PyObject *scr = PyList_GET_ITEM(script_modules, i);
+    while (PyDict_Next(script_modules, &pos, &key, &scr))
         pyscript_cleanup(scr);
-    }
 
     Py_DECREF(script_modules);
 }
@@ -431,5 +892,12 @@ void pyloader_deinit(void)
     g_slist_free(script_paths);
     script_paths = NULL;
 
+    while (autoload_scripts != NULL)
+    {
+        PY_AUTOLOAD_REC *rec = autoload_scripts->data;
+        py_autoload_unbind(rec);
+        py_autoload_destroy(rec);
+    }
+
     py_clear_scripts();
 }
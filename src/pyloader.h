@@ -5,13 +5,21 @@ typedef struct
 {
     char *name;
     char *file;
+    double load_time;
+    int load_cached;
+    int timers; /* pending Script.timer() timers */
+    int pending; /* autorun script not loaded until first used */
 } PY_LIST_REC;
 
 void pyloader_add_script_path(const char *path);
 int pyloader_load_script_argv(char **argv);
 int pyloader_load_script(char *name);
 int pyloader_unload_script(const char *name);
+PyObject *pyloader_find_script(const char *name);
+char *pyloader_find_script_path(const char *name);
 PyObject *pyloader_find_script_obj(void);
+PyObject *pyloader_enter_script(PyObject *script);
+void pyloader_leave_script(PyObject *prev);
 char *pyloader_find_script_name(void);
 
 GSList *pyloader_list(void);
@@ -24,9 +24,11 @@
 #include "factory.h"
 #include "pyutils.h"
 #include "pysignals.h"
+#include "pysource.h"
 #include "pyloader.h"
 #include "pythemes.h"
 #include "pystatusbar.h"
+#include "pystats.h"
 
 /*
  * This module is some what different than the Perl's.
@@ -101,6 +103,37 @@ static PyObject *py_get_script(PyObject *self, PyObject *args)
     return ret;
 }
 
+PyDoc_STRVAR(py_call_soon_threadsafe_doc,
+    "call_soon_threadsafe(func, *args) -> None\n"
+    "\n"
+    "Call func(*args) from Irssi's main loop. Unlike the rest of the API,\n"
+    "this may be called from any thread. Calls run in the order they were\n"
+    "made, and not at all if the script is unloaded first.\n"
+);
+static PyObject *py_call_soon_threadsafe(PyObject *self, PyObject *args)
+{
+    PyObject *func, *fargs;
+    int ret;
+
+    if (PyTuple_GET_SIZE(args) < 1)
+        return PyErr_Format(PyExc_TypeError, "call_soon_threadsafe() takes at least 1 argument");
+
+    func = PyTuple_GET_ITEM(args, 0);
+    if (!PyCallable_Check(func))
+        return PyErr_Format(PyExc_TypeError, "func not callable");
+
+    fargs = PyTuple_GetSlice(args, 1, PyTuple_GET_SIZE(args));
+    if (!fargs)
+        return NULL;
+
+    ret = pysource_post(pyloader_find_script_obj(), func, fargs);
+    Py_DECREF(fargs);
+    if (!ret)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
 PyDoc_STRVAR(py_chatnet_find_doc,
     "chatnet_find(name) -> Chatnet object or None\n"
     "\n"
@@ -1735,11 +1768,54 @@ static PyObject *py_command_runsub(PyObject *self, PyObject *args, PyObject *kwd
     Py_RETURN_NONE;
 }
 
+PyDoc_STRVAR(py_stats_get_doc,
+    "stats_get() -> dict\n"
+    "\n"
+    "Return handler statistics as {script: [entry, ...]}. Each entry is a\n"
+    "dict with type, name, calls, errors, total and max (in seconds).\n"
+);
+static PyObject *py_stats_get(PyObject *self, PyObject *args)
+{
+    return pystats_dict();
+}
+
+PyDoc_STRVAR(py_stats_enable_doc,
+    "stats_enable(enable=True) -> bool\n"
+    "\n"
+    "Turn handler statistics on or off, returns the previous state.\n"
+);
+static PyObject *py_stats_enable(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"enable", NULL};
+    int enable = 1;
+    int prev = pystats_enabled;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", kwlist, 
+           &enable))
+        return NULL;
+
+    pystats_enabled = enable != 0;
+    return PyBool_FromLong(prev);
+}
+
+PyDoc_STRVAR(py_stats_reset_doc,
+    "stats_reset() -> None\n"
+    "\n"
+    "Clear all handler statistics.\n"
+);
+static PyObject *py_stats_reset(PyObject *self, PyObject *args)
+{
+    pystats_reset();
+    Py_RETURN_NONE;
+}
+
 static PyMethodDef ModuleMethods[] = {
     {"prnt", (PyCFunction)py_prnt, METH_VARARGS | METH_KEYWORDS, 
         py_prnt_doc},
     {"get_script", (PyCFunction)py_get_script, METH_NOARGS, 
         py_get_script_doc},
+    {"call_soon_threadsafe", (PyCFunction)py_call_soon_threadsafe, METH_VARARGS, 
+        py_call_soon_threadsafe_doc},
     {"chatnet_find", (PyCFunction)py_chatnet_find, METH_VARARGS | METH_KEYWORDS,
         py_chatnet_find_doc},
     {"chatnets", (PyCFunction)py_chatnets, METH_NOARGS,
@@ -1906,6 +1982,12 @@ static PyMethodDef ModuleMethods[] = {
         py_server_redirect_register_doc},
     {"command_runsub", (PyCFunction)py_command_runsub, METH_VARARGS | METH_KEYWORDS,
         py_command_runsub_doc},
+    {"stats_get", (PyCFunction)py_stats_get, METH_NOARGS,
+        py_stats_get_doc},
+    {"stats_enable", (PyCFunction)py_stats_enable, METH_VARARGS | METH_KEYWORDS,
+        py_stats_enable_doc},
+    {"stats_reset", (PyCFunction)py_stats_reset, METH_NOARGS,
+        py_stats_reset_doc},
     {NULL, NULL, 0, NULL}        /* Sentinel */
 };
 
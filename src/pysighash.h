@@ -0,0 +1,103 @@
+/* Generated from pysigmap.h by sighash.awk, include after it */
+
+#define PY_SIGHASH_BUCKETS 44
+#define PY_SIGHASH_SIZE 223
+
+static const unsigned short py_sighash_disp[PY_SIGHASH_BUCKETS] = {
+    8, 2, 20, 1, 5, 9, 15, 3, 1, 1, 35, 4,
+    25, 4, 4, 7, 1, 1, 4, 5, 6, 26, 4, 37,
+    10, 1, 2, 15, 5, 34, 6, 14, 59, 37, 83, 2,
+    0, 50, 14, 3, 30, 56, 7, 3
+};
+
+/* index into py_sigmap, -1 for empty slots */
+static const short py_sighash_slots[PY_SIGHASH_SIZE] = {
+    1, 84, 174, -1, 180, 24, 156, -1, -1, -1, 70, -1,
+    -1, 9, 57, -1, 106, 38, 157, -1, -1, 8, 86, 41,
+    135, 94, 26, -1, 17, -1, -1, 122, -1, 23, 78, 141,
+    115, 49, 93, 51, -1, 146, 65, 167, 58, 113, -1, 68,
+    -1, 39, 56, 18, -1, 35, 105, 132, -1, 109, -1, 21,
+    155, 159, 4, 120, 12, 34, 67, 47, -1, 52, 150, 11,
+    37, 45, 173, 112, 76, 175, -1, 179, 7, 168, 87, 119,
+    100, 83, -1, 147, -1, 22, 153, -1, 142, 163, -1, 148,
+    116, 114, 145, 59, 177, 80, 160, 158, -1, 143, 162, 25,
+    -1, 181, 139, 69, 77, -1, -1, 165, 33, 104, 5, 54,
+    138, 151, 29, 170, 121, 43, 60, -1, 98, 32, 53, 27,
+    88, -1, 108, 96, 30, 14, 124, 10, 172, -1, 118, 95,
+    90, 3, 31, 127, 140, -1, 161, -1, 66, 130, 16, 178,
+    62, -1, -1, -1, 99, -1, -1, 50, 85, 82, 169, 134,
+    28, 40, 131, 110, 128, 20, 74, 46, 55, -1, -1, 123,
+    -1, 129, 102, 72, 125, 133, 79, 149, 73, -1, 36, -1,
+    6, 2, 48, 44, 81, 101, 154, 19, 164, -1, -1, 126,
+    42, -1, 63, 152, 107, 171, 137, 111, 0, -1, -1, 97,
+    176, 166, 117, 91, 144, 136, -1
+};
+
+/* variable signal prefixes, sorted by name */
+static const short py_sigprefix[] = {
+    15, /* command  */
+    61, /* ctcp msg  */
+    64, /* ctcp reply  */
+    89, /* dcc ctcp  */
+    92, /* dcc reply  */
+    71, /* event  */
+    75, /* redir  */
+};
+
+#define py_sigprefix_len() (sizeof(py_sigprefix) / sizeof(py_sigprefix[0]))
+
+static guint32 py_sighash_str(const char *s, guint32 mult)
+{
+    guint32 h = 0;
+
+    while (*s)
+        h = h * mult + (unsigned char)*s++;
+
+    return h;
+}
+
+/* built-in signal named name, or NULL */
+static PY_SIGNAL_SPEC_REC *py_sigmap_find(const char *name)
+{
+    guint32 bucket, slot;
+    int idx;
+
+    bucket = py_sighash_str(name, 31) % PY_SIGHASH_BUCKETS;
+    slot = py_sighash_str(name, 31 + 2 * py_sighash_disp[bucket]) % PY_SIGHASH_SIZE;
+    idx = py_sighash_slots[slot];
+
+    if (idx >= 0 && strcmp(py_sigmap[idx].name, name) == 0)
+        return &py_sigmap[idx];
+
+    return NULL;
+}
+
+/* built-in variable signal whose prefix begins name, or NULL */
+static PY_SIGNAL_SPEC_REC *py_sigmap_find_prefix(const char *name)
+{
+    int lo = 0, hi = py_sigprefix_len(), i;
+
+    /* find the last prefix <= name */
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+
+        if (strcmp(py_sigmap[py_sigprefix[mid]].name, name) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* a shorter prefix of name may sort before a longer non-matching one */
+    for (i = lo - 1; i >= 0; i--)
+    {
+        PY_SIGNAL_SPEC_REC *spec = &py_sigmap[py_sigprefix[i]];
+
+        if (strncmp(spec->name, name, strlen(spec->name)) == 0)
+            return spec;
+        if (spec->name[0] != name[0])
+            break;
+    }
+
+    return NULL;
+}
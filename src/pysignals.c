@@ -20,7 +20,11 @@
 
 #include <Python.h>
 #include "pyirssi.h"
+#include "pycore.h"
 #include "pysignals.h"
+#include "pyloader.h"
+#include "pystats.h"
+#include "pysource.h"
 #include "factory.h"
 
 /* NOTE:
@@ -59,18 +63,96 @@
  * re-registered. Built-in signals in the sigmap are not from the heap and are 
  * never removed; it is an error for the refcount of any such signal entry to 
  * drop to 0.
+ *
+ * Script signal handlers are not bound to Irssi one by one. Each SPEC_REC
+ * keeps a table of PY_SIGNAL_PROXY_REC entries, one for every exact signal 
+ * text and priority in use, so a variable signal prefix shared by many 
+ * exact signals can find and drop its proxies in constant time. The proxy
+ * is the only handler Irssi knows about; it converts the arguments once 
+ * and hands the same tuple to each PY_SIGNAL_REC bound at that priority,
+ * in the order they were added. A proxy holds a reference to its SPEC_REC
+ * and goes away with its last handler.
+ * Commands are still bound individually through command_bind_full.
+ *
+ * Handlers added with lazy=True are inspected for the number of positional
+ * args they take. Args no handler of a proxy accepts are never converted, 
+ * and when every handler is lazy, nick lists are passed as a LazyList that 
+ * makes wrappers on access.
+ *
+ * Handlers added with parsed=True on "server event", "event <cmd>" or 
+ * "redir <cmd>" get the server and one IrcMessage, made from the line, nick
+ * and address args the first time such a handler is reached.
+ *
+ * A PY_SIGNAL_REC may carry a filter (server tag, target, nick mask, message
+ * level). Filters are tested against the raw irssi args, and the arguments 
+ * are only converted once some handler has passed its filter.
+ *
+ * PY_SIGNAL_HANDLE_REC entries cache a SPEC_REC pointer without holding a 
+ * reference. py_sig_generation changes whenever a SPEC_REC is added to or 
+ * removed from the lookup tables, and a handle with an older generation 
+ * looks its spec up again.
  */
 
-typedef struct _PY_SIGNAL_SPEC_REC 
+typedef struct _PY_SIGNAL_PROXY_REC
 {
-    char *name;
-    char *arglist;
-    int refcount;
-    int dynamic;
-    int is_var; /* is this entry a prefix for a variable signal? */
-} PY_SIGNAL_SPEC_REC;
+    PY_SIGNAL_SPEC_REC *signal;
+    char *name; /* exact signal text, differs from signal->name for variable signals */
+    int priority;
+    int signal_id;
+    GSList *handlers; /* PY_SIGNAL_REC entries */
+    int argc; /* args converted on emit */
+    int eager; /* some handler needs real lists */
+    int dispatching;
+    int dirty; /* handlers removed during dispatch leave NULL entries */
+} PY_SIGNAL_PROXY_REC;
+
+/* Stack of proxies currently dispatching, innermost first. next is the
+ * first handler that has not seen the event yet.
+ */
+typedef struct _PY_DISPATCH_REC
+{
+    PY_SIGNAL_PROXY_REC *proxy;
+    GSList *next;
+    struct _PY_DISPATCH_REC *prev;
+} PY_DISPATCH_REC;
 
 #include "pysigmap.h"
+#include "pysighash.h"
+
+/* Positions of the target, nick and address among the plain string args of
+ * some common signals, for filtering. -1 where the signal has none.
+ */
+static struct
+{
+    const char *signal;
+    int target;
+    int nick;
+    int address;
+} py_filtermap[] = {
+    {"message public", 4, 2, 3},
+    {"message private", -1, 2, 3},
+    {"message own_public", 2, -1, -1},
+    {"message own_private", 2, -1, -1},
+    {"message join", 1, 2, 3},
+    {"message part", 1, 2, 3},
+    {"message quit", -1, 1, 2},
+    {"message kick", 1, 3, 4},
+    {"message nick", -1, 1, 3},
+    {"message own_nick", -1, 1, 3},
+    {"message invite", 1, 2, 3},
+    {"message topic", 1, 3, 4},
+    {"message irc op_public", 4, 2, 3},
+    {"message irc own_wall", 2, -1, -1},
+    {"message irc own_action", 2, -1, -1},
+    {"message irc action", 4, 2, 3},
+    {"message irc own_notice", 2, -1, -1},
+    {"message irc notice", 4, 2, 3},
+    {"message irc own_ctcp", 3, -1, -1},
+    {"message irc ctcp", 5, 3, 4},
+    {"message irc mode", 1, 2, 3},
+    {"event ", -1, 2, 3},
+    {NULL}
+};
 
 #define SIGNAME(sig) (sig->command? sig->command : sig->signal->name)
 /* This macro is useful for PY_SIGNAL_REC entries bound to "variable" signals,
@@ -94,12 +176,48 @@ typedef struct _PY_SIGNAL_SPEC_REC
  * referencing the "massjoin" SPEC_REC entry will have a NULL command.
  */
 
-/* hashtable for normal signals, tree for variable signal prefixes. */
+/* Built-in signals are found through the static tables in pysighash.h. 
+   Signals from pysignals_register go in a hashtable for normal signals 
+   and a tree for variable signal prefixes. */
 static GHashTable *py_sighash = NULL;
 static GTree *py_sigtree = NULL;
 
+/* Full name -> SPEC_REC for names that matched a prefix, so "event 352"
+   is found in one hash lookup the next time. Emptied whenever a signal
+   is added or removed, or when it grows past PY_SIGCACHE_MAX. */
+static GHashTable *py_sigcache = NULL;
+#define PY_SIGCACHE_MAX 1024
+static PY_DISPATCH_REC *py_dispatch = NULL;
+static unsigned int py_sig_generation = 0;
+
+static PyObject *py_mkargtup(const char *arglist, void **args, int argc, int lazy);
+static int py_argtup_set(PyObject **argtup, int i, PyObject *value);
+static int py_argtup_fill(PyObject **argtup, const char *arglist, void **args, 
+        int from, int to);
+static void py_argtup_release(PyObject *argtup);
+static int py_call_handler(PyObject *handler, const char *arglist, 
+        PyObject **argtup, void **args, int argc);
+static int py_call_parsed(PyObject *handler, PY_SIGNAL_PROXY_REC *proxy, 
+        PyObject *argtup, void **args, PyObject **msg);
+static int py_handler_argc(PyObject *func);
+static PY_SIGNAL_FILTER_REC *py_filter_new(const PY_SIGNAL_FILTER_REC *tmpl, 
+        PY_SIGNAL_SPEC_REC *spec, const char *signal);
+static void py_filter_destroy(PY_SIGNAL_FILTER_REC *filter);
+static int py_filter_match(PY_SIGNAL_FILTER_REC *filter, void **args);
 static void py_run_handler(PY_SIGNAL_REC *rec, void **args);
+static int py_batch_queue(PY_SIGNAL_REC *rec, PyObject *argtup);
+static void py_batch_run(PY_SIGNAL_REC *rec);
+static int py_batch_timeout(PY_SIGNAL_REC *rec);
+static void py_batch_invalidate(PyObject *argtup, const char *arglist);
 static void py_sig_proxy(void *p1, void *p2, void *p3, void *p4, void *p5, void *p6);
+static void py_sig_multi_proxy(void *p1, void *p2, void *p3, void *p4, void *p5, void *p6);
+static void py_proxy_dispatch(PY_SIGNAL_PROXY_REC *proxy, GSList *node, void **args);
+static PY_SIGNAL_PROXY_REC *py_proxy_get(PY_SIGNAL_SPEC_REC *spec, 
+        const char *name, int priority);
+static void py_proxy_update(PY_SIGNAL_PROXY_REC *proxy);
+static void py_proxy_detach(PY_SIGNAL_REC *rec);
+static void py_proxy_compact(PY_SIGNAL_PROXY_REC *proxy);
+static void py_proxy_destroy(PY_SIGNAL_PROXY_REC *proxy);
 static void py_signal_ref(PY_SIGNAL_SPEC_REC *sig);
 static int py_signal_unref(PY_SIGNAL_SPEC_REC *sig);
 static void py_signal_add(PY_SIGNAL_SPEC_REC *sig);
@@ -111,54 +229,148 @@ static void *py_py2i(char code, PyObject *pobj, int arg, const char *signal);
 static void py_getstrlist(GList **list, PyObject *pylist);
 static int precmp(const char *spec, const char *test);
 static PY_SIGNAL_SPEC_REC *py_signal_lookup(const char *name);
+static void py_sigcache_clear(void);
 static void py_signal_remove(PY_SIGNAL_SPEC_REC *sig);
-static int py_convert_args(void **args, PyObject *argtup, const char *signal);
+static GSList *py_getnicklist(PyObject *pylist, int arg, const char *signal);
+static int py_convert_args(void **args, PyObject *argtup, 
+        PY_SIGNAL_SPEC_REC *spec, const char *signal, char *codes);
+static void py_free_args(void **args, const char *codes);
 
 PY_SIGNAL_REC *pysignals_command_bind(const char *cmd, PyObject *func, 
-        const char *category, int priority)
+        const char *category, int priority, const PY_SIGNAL_FILTER_REC *filter)
 {
     PY_SIGNAL_REC *rec = py_signal_rec_new("send command", func, cmd);
     g_return_val_if_fail(rec != NULL, NULL);
     
+    if (filter)
+    {
+        rec->filter = py_filter_new(filter, rec->signal, cmd);
+        if (PyErr_Occurred())
+        {
+            py_signal_rec_destroy(rec);
+            return NULL;
+        }
+    }
+
+    rec->priority = priority;
+    rec->category = g_strdup(category);
     command_bind_full(MODULE_NAME, priority, cmd, 
             -1, category, (SIGNAL_FUNC)py_sig_proxy, rec);
 
     return rec;
 }
 
-int pysignals_command_bind_list(GSList **list, const char *command, 
-        PyObject *func, const char *category, int priority)
+static void py_table_add(GHashTable **table, PY_SIGNAL_REC *rec)
+{
+    GSList *list;
+
+    if (*table == NULL)
+        *table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    /* appending to an existing list keeps its head */
+    list = g_hash_table_lookup(*table, SIGNAME(rec));
+    if (list)
+        g_slist_append(list, rec);
+    else
+        g_hash_table_insert(*table, g_strdup(SIGNAME(rec)), g_slist_append(NULL, rec));
+}
+
+int pysignals_command_bind_table(GHashTable **table, const char *command, 
+        PyObject *func, const char *category, int priority, 
+        const PY_SIGNAL_FILTER_REC *filter)
 {
-    PY_SIGNAL_REC *rec = pysignals_command_bind(command, func, category, priority);
+    PY_SIGNAL_REC *rec = pysignals_command_bind(command, func, category, 
+            priority, filter);
     if (!rec)
         return 0;
 
-    *list = g_slist_append(*list, rec);
+    py_table_add(table, rec);
     return 1;
 }
 
 /* return NULL if signal is invalid */
-PY_SIGNAL_REC *pysignals_signal_add(const char *signal, PyObject *func, int priority)
+PY_SIGNAL_REC *pysignals_signal_add(const char *signal, PyObject *func, 
+        int priority, int flags, const PY_SIGNAL_FILTER_REC *filter)
 {
     PY_SIGNAL_REC *rec = py_signal_rec_new(signal, func, NULL);
 
     if (rec == NULL)
         return NULL;
    
-    signal_add_full(MODULE_NAME, priority, SIGNAME(rec), 
-            (SIGNAL_FUNC)py_sig_proxy, rec); 
+    if (filter)
+    {
+        rec->filter = py_filter_new(filter, rec->signal, signal);
+        if (PyErr_Occurred())
+        {
+            py_signal_rec_destroy(rec);
+            return NULL;
+        }
+    }
+
+    if (flags & PY_SIGNAL_PARSED)
+    {
+        PY_SIGNAL_SPEC_REC *spec = rec->signal;
+
+        if (strcmp(spec->arglist, "Ssss") != 0 || 
+                (!spec->is_var && strcmp(spec->name, "server event") != 0))
+        {
+            PyErr_Format(PyExc_ValueError, "`%s' has no IRC line to parse", signal);
+            py_signal_rec_destroy(rec);
+            return NULL;
+        }
+
+        rec->parsed = TRUE;
+        rec->argc = 1;
+    }
+    else if (flags & PY_SIGNAL_LAZY)
+    {
+        rec->lazy = TRUE;
+        rec->argc = py_handler_argc(func);
+    }
+
+    rec->priority = priority;
+    rec->proxy = py_proxy_get(rec->signal, SIGNAME(rec), priority);
+    rec->proxy->handlers = g_slist_append(rec->proxy->handlers, rec);
+    py_proxy_update(rec->proxy);
 
     return rec;
 }
 
-int pysignals_signal_add_list(GSList **list, const char *signal, 
-        PyObject *func, int priority)
+int pysignals_signal_add_table(GHashTable **table, const char *signal, 
+        PyObject *func, int priority, int flags, 
+        const PY_SIGNAL_FILTER_REC *filter)
 {
-    PY_SIGNAL_REC *rec = pysignals_signal_add(signal, func, priority);
+    PY_SIGNAL_REC *rec = pysignals_signal_add(signal, func, priority, flags, filter);
+    if (!rec)
+        return 0;
+
+    py_table_add(table, rec);
+    return 1;
+}
+
+int pysignals_signal_add_batched_table(GHashTable **table, const char *signal, 
+        PyObject *func, int priority, int size, int msecs, 
+        const PY_SIGNAL_FILTER_REC *filter)
+{
+    PY_SIGNAL_REC *rec;
+    PyObject *batch;
+
+    batch = PyList_New(0);
+    if (!batch)
+        return 0;
+
+    rec = pysignals_signal_add(signal, func, priority, 0, filter);
     if (!rec)
+    {
+        Py_DECREF(batch);
         return 0;
+    }
+
+    rec->batch = batch;
+    rec->batch_size = size > 0? size : 1;
+    rec->batch_msecs = msecs;
 
-    *list = g_slist_append(*list, rec);
+    py_table_add(table, rec);
     return 1;
 }
 
@@ -167,7 +379,8 @@ void pysignals_command_unbind(PY_SIGNAL_REC *rec)
     g_return_if_fail(rec->is_signal == FALSE);
     g_return_if_fail(rec->command != NULL);
 
-    command_unbind_full(rec->command, (SIGNAL_FUNC)py_sig_proxy, rec);
+    if (!rec->suspended)
+        command_unbind_full(rec->command, (SIGNAL_FUNC)py_sig_proxy, rec);
     py_signal_rec_destroy(rec);
 }
 
@@ -175,10 +388,54 @@ void pysignals_signal_remove(PY_SIGNAL_REC *rec)
 {
     g_return_if_fail(rec->is_signal == TRUE);
 
-    signal_remove_full(SIGNAME(rec), (SIGNAL_FUNC)py_sig_proxy, rec);
+    if (!rec->suspended)
+        py_proxy_detach(rec);
     py_signal_rec_destroy(rec);
 }
 
+/* Unbind from irssi but keep the record in the script's list. A suspended 
+ * binding has no irssi handler, so it costs nothing until resumed.
+ */
+void pysignals_suspend(PY_SIGNAL_REC *rec)
+{
+    if (rec->suspended)
+        return;
+
+    if (rec->is_signal)
+        py_proxy_detach(rec);
+    else
+        command_unbind_full(rec->command, (SIGNAL_FUNC)py_sig_proxy, rec);
+
+    rec->suspended = TRUE;
+
+    printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+            "Python script %s: suspended %s `%s', use /py resume %s to re-enable",
+            rec->stats->script, rec->stats->type, SIGNAME(rec), rec->stats->script);
+}
+
+/* returns 1 if rec was suspended */
+int pysignals_resume(PY_SIGNAL_REC *rec)
+{
+    if (!rec->suspended)
+        return 0;
+
+    rec->suspended = FALSE;
+    rec->stats->overruns = 0;
+    rec->stats->warned = FALSE;
+
+    if (rec->is_signal)
+    {
+        rec->proxy = py_proxy_get(rec->signal, SIGNAME(rec), rec->priority);
+        rec->proxy->handlers = g_slist_append(rec->proxy->handlers, rec);
+        py_proxy_update(rec->proxy);
+    }
+    else
+        command_bind_full(MODULE_NAME, rec->priority, rec->command, 
+                -1, rec->category, (SIGNAL_FUNC)py_sig_proxy, rec);
+
+    return 1;
+}
+
 void pysignals_remove_generic(PY_SIGNAL_REC *rec)
 {
     if (rec->is_signal)
@@ -188,12 +445,16 @@ void pysignals_remove_generic(PY_SIGNAL_REC *rec)
 }
 
 /* returns 1 when found and removed successfully */
-int pysignals_remove_search(GSList **siglist, const char *name, 
+int pysignals_remove_search(GHashTable *table, const char *name, 
         PyObject *func, PSG_TYPE type)
 {
-    GSList *node;
+    GSList *list, *node;
 
-    for (node = *siglist; node != NULL; node = node->next)
+    if (table == NULL)
+        return 0;
+
+    list = g_hash_table_lookup(table, name);
+    for (node = list; node != NULL; node = node->next)
     {
         PY_SIGNAL_REC *sig = node->data;
 
@@ -201,11 +462,20 @@ int pysignals_remove_search(GSList **siglist, const char *name,
                 (!sig->is_signal && type == PSG_SIGNAL))
             continue;
         
-        if ((strcmp(SIGNAME(sig), name) == 0) && 
-                (func == NULL || func == sig->handler))
+        if (func == NULL || func == sig->handler)
         {
             pysignals_remove_generic(sig);
-            *siglist = g_slist_delete_link(*siglist, node);
+
+            if (node == list)
+            {
+                list = g_slist_delete_link(list, node);
+                if (list)
+                    g_hash_table_insert(table, g_strdup(name), list);
+                else
+                    g_hash_table_remove(table, name);
+            }
+            else
+                list = g_slist_delete_link(list, node);
 
             /* deleting node won't harm iteration because it quits here */
             return 1;
@@ -215,12 +485,46 @@ int pysignals_remove_search(GSList **siglist, const char *name,
     return 0;
 }
 
-void pysignals_remove_list(GSList *siglist)
+static void py_table_remove(char *name, GSList *list, void *data)
 {
-    GSList *node = siglist;
+    GSList *node;
 
-    for (node = siglist; node != NULL; node = node->next)
+    for (node = list; node != NULL; node = node->next)
         pysignals_remove_generic(node->data);
+    g_slist_free(list);
+}
+
+/* remove every binding in the table and destroy it */
+void pysignals_remove_table(GHashTable *table)
+{
+    if (table == NULL)
+        return;
+
+    g_hash_table_foreach(table, (GHFunc)py_table_remove, NULL);
+    g_hash_table_destroy(table);
+}
+
+static void py_table_resume(char *name, GSList *list, int *count)
+{
+    for (; list != NULL; list = list->next)
+        *count += pysignals_resume(list->data);
+}
+
+/* resume suspended bindings, all of them or those named name. Returns 
+   the number resumed. */
+int pysignals_resume_table(GHashTable *table, const char *name)
+{
+    int count = 0;
+
+    if (table == NULL)
+        return 0;
+
+    if (name)
+        py_table_resume(NULL, g_hash_table_lookup(table, name), &count);
+    else
+        g_hash_table_foreach(table, (GHFunc)py_table_resume, &count);
+
+    return count;
 }
 
 static PyObject *py_mkstrlist(void *iobj)
@@ -343,8 +647,9 @@ static void *py_py2i(char code, PyObject *pobj, int arg, const char *signal)
             break;
 
         case 'L': /* list of nicks */
-            /*FIXME*/
-            return NULL;
+            type = "list";
+            if (PyList_Check(pobj)) return py_getnicklist(pobj, arg, signal);
+            break;
 
         case 'c':
             type = "Chatnet";
@@ -434,6 +739,30 @@ static void *py_py2i(char code, PyObject *pobj, int arg, const char *signal)
     return NULL;
 }
 
+/* list of Nick objects -> GSList, free with g_slist_free */
+static GSList *py_getnicklist(PyObject *pylist, int arg, const char *signal)
+{
+    GSList *out = NULL;
+    int i;
+
+    for (i = 0; i < PyList_Size(pylist); i++)
+    {
+        PyObject *nick = PyList_GET_ITEM(pylist, i);
+        if (!pynick_check(nick) || !DATA(nick))
+        {
+            PyErr_Format(PyExc_TypeError, 
+                    "signal `%s': arg %d must be a list of valid Nick objects", 
+                    signal, arg);
+            g_slist_free(out);
+            return NULL;
+        }
+
+        out = g_slist_prepend(out, DATA(nick));
+    }
+
+    return g_slist_reverse(out);
+}
+
 static void py_getstrlist(GList **list, PyObject *pylist)
 {
     GList *out = NULL;
@@ -460,41 +789,342 @@ static void py_getstrlist(GList **list, PyObject *pylist)
     *list = out;
 }
 
-static void py_run_handler(PY_SIGNAL_REC *rec, void **args)
+/* Convert the first argc args (all if argc < 0), the rest are None. With
+ * lazy set, nick lists become LazyList objects.
+ */
+static PyObject *py_mkargtup(const char *arglist, void **args, int argc, int lazy)
 {
-    PyObject *argtup, *ret;
-    char *arglist = rec->signal->arglist;
-    int arglen, i, j;
+    PyObject *argtup;
+    int arglen, i;
 
     arglen = strlen(arglist);
-    g_return_if_fail(arglen <= SIGNAL_MAX_ARGUMENTS);
+    g_return_val_if_fail(arglen <= SIGNAL_MAX_ARGUMENTS, NULL);
     
+    if (argc < 0 || argc > arglen)
+        argc = arglen;
+
     argtup = PyTuple_New(arglen);
     if (!argtup)
-        goto error;
+        return NULL;
 
     for (i = 0; i < arglen; i++)
     {
-        PyObject *arg = py_i2py(arglist[i], args[i]);
+        PyObject *arg;
+        
+        if (i >= argc)
+        {
+            arg = Py_None;
+            Py_INCREF(arg);
+        }
+        else if (lazy && arglist[i] == 'L' && args[i] != NULL)
+            arg = pylazylist_new((GSList *)args[i], 1, py_irssi_chat_new);
+        else
+            arg = py_i2py(arglist[i], args[i]);
+
         if (!arg)
-            goto error;
+        {
+            Py_DECREF(argtup);
+            return NULL;
+        }
 
         PyTuple_SET_ITEM(argtup, i, arg);
     }
-    
-    ret = PyObject_CallObject(rec->handler, argtup);
+
+    return argtup;
+}
+
+/* Replace an item of a shared argument tuple, steals value. If a handler 
+ * kept the tuple, later handlers get a copy so the kept one doesn't change.
+ */
+static int py_argtup_set(PyObject **argtup, int i, PyObject *value)
+{
+    PyObject *tup = *argtup;
+
+    if (tup->ob_refcnt > 1)
+    {
+        int j, size = PyTuple_GET_SIZE(tup);
+
+        tup = PyTuple_New(size);
+        if (!tup)
+        {
+            Py_DECREF(value);
+            return 0;
+        }
+
+        for (j = 0; j < size; j++)
+        {
+            PyObject *item = PyTuple_GET_ITEM(*argtup, j);
+            Py_INCREF(item);
+            PyTuple_SET_ITEM(tup, j, item);
+        }
+
+        Py_DECREF(*argtup);
+        *argtup = tup;
+    }
+
+    Py_DECREF(PyTuple_GET_ITEM(tup, i));
+    PyTuple_SET_ITEM(tup, i, value);
+
+    return 1;
+}
+
+/* convert args skipped by py_mkargtup, for a handler bound mid-dispatch */
+static int py_argtup_fill(PyObject **argtup, const char *arglist, void **args, 
+        int from, int to)
+{
+    int i;
+
+    for (i = from; i < to && arglist[i]; i++)
+    {
+        PyObject *arg = py_i2py(arglist[i], args[i]);
+        if (!arg || !py_argtup_set(argtup, i, arg))
+            return 0;
+    }
+
+    return 1;
+}
+
+/* records in lazy lists go stale once the emit is over */
+static void py_argtup_release(PyObject *argtup)
+{
+    int i;
+
+    for (i = 0; i < PyTuple_GET_SIZE(argtup); i++)
+    {
+        PyObject *arg = PyTuple_GET_ITEM(argtup, i);
+        if (pylazylist_check(arg))
+            pylazylist_release(arg);
+    }
+}
+
+/* number of positional args func takes, -1 if unknown or unlimited */
+static int py_handler_argc(PyObject *func)
+{
+    PyCodeObject *code;
+    int bound = 0;
+
+    if (PyMethod_Check(func))
+    {
+        bound = PyMethod_GET_SELF(func) != NULL;
+        func = PyMethod_GET_FUNCTION(func);
+    }
+
+    if (!PyFunction_Check(func))
+        return -1;
+
+    code = (PyCodeObject *)PyFunction_GET_CODE(func);
+    if (code->co_flags & CO_VARARGS)
+        return -1;
+
+    if (code->co_argcount < bound)
+        return 0;
+
+    return code->co_argcount - bound;
+}
+
+/* Compile a filter template against the signal's arglist. Returns NULL 
+ * without an exception when the template is empty.
+ */
+static PY_SIGNAL_FILTER_REC *py_filter_new(const PY_SIGNAL_FILTER_REC *tmpl, 
+        PY_SIGNAL_SPEC_REC *spec, const char *signal)
+{
+    PY_SIGNAL_FILTER_REC *filter;
+    const char *arglist = spec->arglist;
+    const char *what = NULL;
+    int i;
+
+    if (!tmpl->tag && !tmpl->target && !tmpl->mask && !tmpl->level)
+        return NULL;
+
+    filter = g_new0(PY_SIGNAL_FILTER_REC, 1);
+    filter->server_arg = filter->item_arg = filter->target_arg = -1;
+    filter->nick_arg = filter->address_arg = filter->dest_arg = -1;
+
+    for (i = 0; arglist[i]; i++)
+    {
+        switch (arglist[i])
+        {
+            case 'S':
+                if (filter->server_arg < 0)
+                    filter->server_arg = i;
+                break;
+            case 'C':
+            case 'q':
+            case 'W':
+                if (filter->item_arg < 0)
+                    filter->item_arg = i;
+                break;
+            case 'n':
+                if (filter->nick_arg < 0)
+                {
+                    filter->nick_arg = i;
+                    filter->nick_is_rec = TRUE;
+                }
+                break;
+            case 't':
+                if (filter->dest_arg < 0)
+                    filter->dest_arg = i;
+                break;
+        }
+    }
+
+    for (i = 0; py_filtermap[i].signal != NULL; i++)
+    {
+        if (strcmp(py_filtermap[i].signal, spec->name) == 0)
+        {
+            filter->target_arg = py_filtermap[i].target;
+            if (py_filtermap[i].nick >= 0)
+            {
+                filter->nick_arg = py_filtermap[i].nick;
+                filter->nick_is_rec = FALSE;
+                filter->address_arg = py_filtermap[i].address;
+            }
+            break;
+        }
+    }
+
+    if (tmpl->tag && filter->server_arg < 0 && filter->item_arg < 0 &&
+            filter->dest_arg < 0)
+        what = "server";
+    else if (tmpl->target && filter->target_arg < 0 && filter->item_arg < 0 && 
+            filter->dest_arg < 0)
+        what = "target";
+    else if (tmpl->mask && filter->nick_arg < 0)
+        what = "nick";
+    else if (tmpl->level && filter->dest_arg < 0)
+        what = "TextDest";
+
+    if (what)
+    {
+        PyErr_Format(PyExc_ValueError, "`%s' has no %s argument to filter on", 
+                signal, what);
+        g_free(filter);
+        return NULL;
+    }
+
+    filter->tag = g_strdup(tmpl->tag);
+    filter->target = g_strdup(tmpl->target);
+    filter->mask = g_strdup(tmpl->mask);
+    filter->level = tmpl->level;
+
+    return filter;
+}
+
+static void py_filter_destroy(PY_SIGNAL_FILTER_REC *filter)
+{
+    g_free(filter->tag);
+    g_free(filter->target);
+    g_free(filter->mask);
+    g_free(filter);
+}
+
+static int py_filter_match(PY_SIGNAL_FILTER_REC *filter, void **args)
+{
+    SERVER_REC *server = NULL;
+    WI_ITEM_REC *item = NULL;
+    TEXT_DEST_REC *dest = NULL;
+
+    if (filter->item_arg >= 0)
+        item = args[filter->item_arg];
+    if (filter->dest_arg >= 0)
+        dest = args[filter->dest_arg];
+
+    if (filter->server_arg >= 0)
+        server = args[filter->server_arg];
+    else if (item)
+        server = item->server;
+    else if (dest)
+        server = dest->server;
+
+    if (filter->level && (!dest || !(dest->level & filter->level)))
+        return FALSE;
+
+    if (filter->tag && (!server || g_strcasecmp(server->tag, filter->tag)))
+        return FALSE;
+
+    if (filter->target)
+    {
+        const char *target = NULL;
+
+        if (filter->target_arg >= 0)
+            target = args[filter->target_arg];
+        else if (item)
+            target = item->visible_name;
+        else if (dest)
+            target = dest->target;
+
+        if (!target || g_strcasecmp(target, filter->target))
+            return FALSE;
+    }
+
+    if (filter->mask)
+    {
+        const char *nick, *address = NULL;
+
+        if (filter->nick_is_rec)
+        {
+            NICK_REC *nickrec = args[filter->nick_arg];
+
+            nick = nickrec? nickrec->nick : NULL;
+            address = nickrec? nickrec->host : NULL;
+        }
+        else
+        {
+            nick = args[filter->nick_arg];
+            if (filter->address_arg >= 0)
+                address = args[filter->address_arg];
+        }
+
+        if (!nick || !mask_match_address(server, filter->mask, nick, 
+                    address? address : ""))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Call one handler with the first argc args (all if argc < 0), then copy 
+ * IN/OUT args back to irssi. An 'I' arg set by the handler is also stored 
+ * in argtup for the handlers that follow. Returns 0 if an error was printed.
+ */
+static int py_call_handler(PyObject *handler, const char *arglist, 
+        PyObject **argtup, void **args, int argc)
+{
+    PyObject *callargs, *ret;
+    int i, j;
+
+    if (argc >= 0 && argc < PyTuple_GET_SIZE(*argtup))
+        callargs = PyTuple_GetSlice(*argtup, 0, argc);
+    else
+    {
+        callargs = *argtup;
+        Py_INCREF(callargs);
+    }
+
+    if (!callargs)
+        goto error;
+
+    /* the handler may unbind itself */
+    Py_INCREF(handler);
+    ret = PyObject_CallObject(handler, callargs);
+    Py_DECREF(handler);
+    Py_DECREF(callargs);
     if (!ret)
         goto error;
   
     /*XXX: IN/OUT arg handling not well tested */
-    for (i = 0, j = 0; i < arglen; i++)
+    for (i = 0, j = 0; arglist[i]; i++)
     {
         GList **list;
-        PyObject *pyarg = PyTuple_GET_ITEM(argtup, i);
+        PyObject *pyarg = PyTuple_GET_ITEM(*argtup, i);
         
         switch (arglist[i])
         {
             case 'G':
+                /* not converted for this handler */
+                if (!PyList_Check(pyarg))
+                    break;
+
                 list = args[i];
                 py_getstrlist(list, pyarg);
                 break;
@@ -517,69 +1147,503 @@ static void py_run_handler(PY_SIGNAL_REC *rec, void **args)
                         continue;
 
                     *intarg = PyInt_AS_LONG(value);
+
+                    Py_INCREF(value);
+                    if (!py_argtup_set(argtup, i, value))
+                        goto done;
                 }
                 break;
         }
     }
     
-    Py_XDECREF(ret);
+done:
+    Py_DECREF(ret);
 
 error:
-    Py_XDECREF(argtup);
     if (PyErr_Occurred())
+    {
         PyErr_Print();
+        return 0;
+    }
+
+    return 1;
 }
 
+/* Call a handler added with parsed=True as func(server, msg). msg is made
+ * on the first call and shared by the handlers that follow. Returns 0 if
+ * an error was printed.
+ */
+static int py_call_parsed(PyObject *handler, PY_SIGNAL_PROXY_REC *proxy, 
+        PyObject *argtup, void **args, PyObject **msg)
+{
+    PyObject *ret;
+
+    if (!*msg)
+    {
+        const char *command = NULL;
+
+        /* "event <cmd>" lines come without the command */
+        if (proxy->signal->is_var)
+            command = proxy->name + strlen(proxy->signal->name);
+
+        *msg = pyircmessage_new(args[1]? args[1] : "", command, 
+                args[2], args[3]);
+        if (!*msg)
+            goto error;
+    }
+
+    Py_INCREF(handler);
+    ret = PyObject_CallFunctionObjArgs(handler, 
+            PyTuple_GET_ITEM(argtup, 0), *msg, NULL);
+    Py_DECREF(handler);
+    if (!ret)
+        goto error;
+
+    Py_DECREF(ret);
+    return 1;
+
+error:
+    PyErr_Print();
+    return 0;
+}
+
+static void py_run_handler(PY_SIGNAL_REC *rec, void **args)
+{
+    PY_STATS_REC *stats = rec->stats;
+    PyObject *argtup, *script;
+    double start;
+    int ok;
+    
+    if (rec->filter && !py_filter_match(rec->filter, args))
+        return;
+
+    argtup = py_mkargtup(rec->signal->arglist, args, -1, FALSE);
+    if (!argtup)
+    {
+        if (PyErr_Occurred())
+            PyErr_Print();
+        return;
+    }
+
+    script = pyloader_enter_script(rec->script);
+    start = pystats_begin(stats);
+    ok = py_call_handler(rec->handler, rec->signal->arglist, &argtup, args, -1);
+    if (pystats_end(stats, start, ok))
+        pysignals_suspend(rec);
+    pyloader_leave_script(script);
+
+    Py_DECREF(argtup);
+}
+
+/* used for commands, one irssi binding per PY_SIGNAL_REC */
 static void py_sig_proxy(void *p1, void *p2, void *p3, void *p4, void *p5, void *p6)
 {
     PY_SIGNAL_REC *rec = signal_get_user_data();
     void *args[6];
+    int gil;
 
     args[0] = p1; args[1] = p2; args[2] = p3;
     args[3] = p4; args[4] = p5; args[5] = p6;
+    gil = python_gil_enter();
     py_run_handler(rec, args);
+    python_gil_leave(gil);
 }
 
-static int py_convert_args(void **args, PyObject *argtup, const char *signal)
+/* used for signals, one irssi binding per PY_SIGNAL_PROXY_REC */
+static void py_sig_multi_proxy(void *p1, void *p2, void *p3, void *p4, void *p5, void *p6)
 {
-    char *arglist;
-    PY_SIGNAL_SPEC_REC *spec;
-    int i;
-    int maxargs;
+    PY_SIGNAL_PROXY_REC *proxy = signal_get_user_data();
+    void *args[6];
+    int gil;
 
-    spec = py_signal_lookup(signal);
-    if (!spec)
+    args[0] = p1; args[1] = p2; args[2] = p3;
+    args[3] = p4; args[4] = p5; args[5] = p6;
+    gil = python_gil_enter();
+    py_proxy_dispatch(proxy, proxy->handlers, args);
+    python_gil_leave(gil);
+}
+
+/* run handlers starting at node until the list ends or the signal is stopped */
+static void py_proxy_dispatch(PY_SIGNAL_PROXY_REC *proxy, GSList *node, void **args)
+{
+    PY_DISPATCH_REC frame;
+    PyObject *argtup = NULL;
+    PyObject *msg = NULL;
+    const char *arglist = proxy->signal->arglist;
+    int converted = proxy->argc;
+    int queued = FALSE;
+
+    frame.proxy = proxy;
+    frame.next = node;
+    frame.prev = py_dispatch;
+    py_dispatch = &frame;
+    proxy->dispatching++;
+
+    while (frame.next != NULL)
     {
-        PyErr_Format(PyExc_KeyError, "signal not found");
+        PY_SIGNAL_REC *rec = frame.next->data;
+        PY_STATS_REC *stats;
+        PyObject *script;
+        double start;
+        int ok;
+
+        frame.next = frame.next->next;
+        if (rec == NULL)
+            continue;
+
+        if (rec->filter && !py_filter_match(rec->filter, args))
+            continue;
+
+        /* nothing is converted until some handler wants the event */
+        if (!argtup)
+        {
+            argtup = py_mkargtup(arglist, args, converted, !proxy->eager);
+            if (!argtup)
+            {
+                if (PyErr_Occurred())
+                    PyErr_Print();
+                break;
+            }
+        }
+
+        if (rec->argc < 0 || rec->argc > converted)
+        {
+            int argc = rec->argc < 0 ? PyTuple_GET_SIZE(argtup) : rec->argc;
+
+            if (!py_argtup_fill(&argtup, arglist, args, converted, argc))
+            {
+                PyErr_Print();
+                continue;
+            }
+
+            converted = argc;
+        }
+
+        if (rec->batch)
+        {
+            if (!py_batch_queue(rec, argtup))
+                PyErr_Print();
+            queued = TRUE;
+            continue;
+        }
+
+        stats = rec->stats;
+        script = pyloader_enter_script(rec->script);
+        start = pystats_begin(stats);
+        if (rec->parsed)
+            ok = py_call_parsed(rec->handler, proxy, argtup, args, &msg);
+        else
+            ok = py_call_handler(rec->handler, arglist, &argtup, args, rec->argc);
+        if (pystats_end(stats, start, ok))
+            pysignals_suspend(rec);
+        pyloader_leave_script(script);
+
+        if (signal_is_stopped(proxy->signal_id))
+            break;
+    }
+
+    proxy->dispatching--;
+    py_dispatch = frame.prev;
+    if (argtup)
+    {
+        if (queued)
+            py_batch_invalidate(argtup, arglist);
+        py_argtup_release(argtup);
+        Py_DECREF(argtup);
+    }
+    Py_XDECREF(msg);
+
+    if (proxy->dispatching == 0 && proxy->dirty)
+        py_proxy_compact(proxy);
+}
+
+/* Queue a batched handler's args. The tuple is shared with the handlers
+ * that follow, which is fine since py_argtup_set copies it before any 
+ * change. Returns 0 if an exception is set.
+ */
+static int py_batch_queue(PY_SIGNAL_REC *rec, PyObject *argtup)
+{
+    if (PyList_Append(rec->batch, argtup) != 0)
         return 0;
+
+    if (PyList_GET_SIZE(rec->batch) >= rec->batch_size)
+        py_batch_run(rec);
+    else if (rec->batch_tag == 0)
+        rec->batch_tag = pysource_flush_add(rec->batch_msecs, 
+                (GSourceFunc)py_batch_timeout, rec);
+
+    return 1;
+}
+
+/* Hand the queued tuples to the handler. rec may be gone when the 
+   handler returns. */
+static void py_batch_run(PY_SIGNAL_REC *rec)
+{
+    PY_STATS_REC *stats = rec->stats;
+    PyObject *batch, *handler, *ret, *script;
+    double start;
+
+    if (rec->batch_tag)
+    {
+        g_source_remove(rec->batch_tag);
+        rec->batch_tag = 0;
+    }
+
+    if (PyList_GET_SIZE(rec->batch) == 0)
+        return;
+
+    batch = PyList_New(0);
+    if (!batch)
+    {
+        PyErr_Print();
+        return;
+    }
+
+    /* swap first, so events the handler causes start a new batch */
+    handler = rec->handler;
+    Py_INCREF(handler);
+    ret = rec->batch;
+    rec->batch = batch;
+    batch = ret;
+
+    script = pyloader_enter_script(rec->script);
+    start = pystats_begin(stats);
+    ret = PyObject_CallFunctionObjArgs(handler, batch, NULL);
+    Py_DECREF(handler);
+    Py_DECREF(batch);
+
+    if (!ret)
+        PyErr_Print();
+    else
+        Py_DECREF(ret);
+
+    if (pystats_end(stats, start, ret != NULL))
+        pysignals_suspend(rec);
+    pyloader_leave_script(script);
+}
+
+static int py_batch_timeout(PY_SIGNAL_REC *rec)
+{
+    int gil;
+
+    rec->batch_tag = 0;
+    gil = python_gil_enter();
+    py_batch_run(rec);
+    python_gil_leave(gil);
+
+    return FALSE;
+}
+
+/* Queued args outlive the signal. Records with a cleanup signal are 
+ * invalidated by the cleanup registry when irssi destroys them, and their
+ * wrappers may be shared through the wrapper cache, so they must be left
+ * alone. Reconnect, rawlog and text dest records have no cleanup signal 
+ * and text dests usually live on the stack. Their wrappers are made fresh
+ * for each signal (a server's own rawlog wrapper is never passed here), 
+ * so they are cut loose here.
+ */
+static void py_batch_invalidate(PyObject *argtup, const char *arglist)
+{
+    int i;
+
+    for (i = 0; arglist[i] && i < PyTuple_GET_SIZE(argtup); i++)
+    {
+        PyObject *obj = PyTuple_GET_ITEM(argtup, i);
+
+        if (obj == Py_None || !strchr("rat", arglist[i]))
+            continue;
+
+        ((PyIrssiObject *)obj)->data = NULL;
+    }
+}
+
+static unsigned int py_proxy_hash(PY_SIGNAL_PROXY_REC *proxy)
+{
+    return g_str_hash(proxy->name) ^ (unsigned int)proxy->priority;
+}
+
+static int py_proxy_equal(PY_SIGNAL_PROXY_REC *a, PY_SIGNAL_PROXY_REC *b)
+{
+    return a->priority == b->priority && strcmp(a->name, b->name) == 0;
+}
+
+static PY_SIGNAL_PROXY_REC *py_proxy_get(PY_SIGNAL_SPEC_REC *spec, 
+        const char *name, int priority)
+{
+    PY_SIGNAL_PROXY_REC *proxy, key;
+
+    if (spec->proxies == NULL)
+        spec->proxies = g_hash_table_new((GHashFunc)py_proxy_hash, 
+                (GEqualFunc)py_proxy_equal);
+
+    key.name = (char *)name;
+    key.priority = priority;
+    proxy = g_hash_table_lookup(spec->proxies, &key);
+    if (proxy)
+        return proxy;
+
+    proxy = g_new0(PY_SIGNAL_PROXY_REC, 1);
+    proxy->signal = spec;
+    proxy->name = g_strdup(name);
+    proxy->priority = priority;
+    proxy->signal_id = signal_get_uniq_id(name);
+    
+    g_hash_table_insert(spec->proxies, proxy, proxy);
+    py_signal_ref(spec);
+    
+    signal_add_full(MODULE_NAME, priority, name, 
+            (SIGNAL_FUNC)py_sig_multi_proxy, proxy); 
+
+    return proxy;
+}
+
+static void py_proxy_update(PY_SIGNAL_PROXY_REC *proxy)
+{
+    GSList *node;
+    int arglen = strlen(proxy->signal->arglist);
+
+    proxy->argc = 0;
+    proxy->eager = FALSE;
+
+    for (node = proxy->handlers; node != NULL; node = node->next)
+    {
+        PY_SIGNAL_REC *rec = node->data;
+        
+        if (rec == NULL)
+            continue;
+
+        if (!rec->lazy)
+            proxy->eager = TRUE;
+
+        if (rec->argc < 0 || rec->argc > arglen)
+            proxy->argc = arglen;
+        else if (rec->argc > proxy->argc)
+            proxy->argc = rec->argc;
+    }
+}
+
+static void py_proxy_detach(PY_SIGNAL_REC *rec)
+{
+    PY_SIGNAL_PROXY_REC *proxy = rec->proxy;
+    GSList *node;
+
+    g_return_if_fail(proxy != NULL);
+    
+    node = g_slist_find(proxy->handlers, rec);
+    g_return_if_fail(node != NULL);
+
+    rec->proxy = NULL;
+    
+    /* don't pull links out from under a running dispatch */
+    if (proxy->dispatching)
+    {
+        node->data = NULL;
+        proxy->dirty = TRUE;
+        py_proxy_update(proxy);
+        return;
+    }
+
+    proxy->handlers = g_slist_delete_link(proxy->handlers, node);
+    if (proxy->handlers == NULL)
+        py_proxy_destroy(proxy);
+    else
+        py_proxy_update(proxy);
+}
+
+static void py_proxy_compact(PY_SIGNAL_PROXY_REC *proxy)
+{
+    proxy->handlers = g_slist_remove_all(proxy->handlers, NULL);
+    proxy->dirty = FALSE;
+
+    if (proxy->handlers == NULL)
+        py_proxy_destroy(proxy);
+}
+
+static void py_proxy_destroy(PY_SIGNAL_PROXY_REC *proxy)
+{
+    PY_SIGNAL_SPEC_REC *spec = proxy->signal;
+
+    signal_remove_full(proxy->name, (SIGNAL_FUNC)py_sig_multi_proxy, proxy);
+    g_hash_table_remove(spec->proxies, proxy);
+    if (g_hash_table_size(spec->proxies) == 0)
+    {
+        g_hash_table_destroy(spec->proxies);
+        spec->proxies = NULL;
     }
 
+    g_slist_free(proxy->handlers);
+    g_free(proxy->name);
+    g_free(proxy);
+
+    py_signal_unref(spec);
+}
+
+/* codes receives a copy of the arglist, for py_free_args */
+static int py_convert_args(void **args, PyObject *argtup, 
+        PY_SIGNAL_SPEC_REC *spec, const char *signal, char *codes)
+{
+    char *arglist;
+    int i;
+    int maxargs;
+
+    codes[0] = '\0';
+
     /*XXX: specifying fewer signal args than in the format implicitly 
       sets overlooked args to NULL or 0 */
 
     arglist = spec->arglist;
     maxargs = strlen(arglist);
+    g_return_val_if_fail(maxargs <= SIGNAL_MAX_ARGUMENTS, -1);
+    strcpy(codes, arglist);
+
     for (i = 0; i < maxargs && i < PyTuple_Size(argtup); i++)
     {
         args[i] = py_py2i(arglist[i], 
                 PyTuple_GET_ITEM(argtup, i), 
                 i+1, signal);
 
-        if (PyErr_Occurred()) /* XXX: any cleanup needed? */
+        if (PyErr_Occurred())
+        {
+            py_free_args(args, codes);
             return -1;
+        }
     }
 
     return maxargs;
 }
 
+/* free temporaries made by py_convert_args */
+static void py_free_args(void **args, const char *codes)
+{
+    int i;
+
+    for (i = 0; codes[i]; i++)
+    {
+        if (codes[i] == 'L')
+        {
+            g_slist_free(args[i]);
+            args[i] = NULL;
+        }
+    }
+}
+
 int pysignals_emit(const char *signal, PyObject *argtup)
 {
+    PY_SIGNAL_SPEC_REC *spec;
     int arglen;
     void *args[6];
+    char codes[SIGNAL_MAX_ARGUMENTS + 1];
 
     memset(args, 0, sizeof args);
 
-    arglen = py_convert_args(args, argtup, signal);
+    spec = py_signal_lookup(signal);
+    if (!spec)
+    {
+        PyErr_Format(PyExc_KeyError, "signal not found");
+        return 0;
+    }
+
+    arglen = py_convert_args(args, argtup, spec, signal, codes);
     if (arglen < 0)
         return 0;
 
@@ -587,32 +1651,130 @@ int pysignals_emit(const char *signal, PyObject *argtup)
             args[0], args[1], args[2],   
             args[3], args[4], args[5]);
 
+    py_free_args(args, codes);
     return 1;
 }
 
 int pysignals_continue(PyObject *argtup)
 {
     const char *signal;
+    PY_SIGNAL_SPEC_REC *spec;
+    PY_SIGNAL_PROXY_REC *proxy = NULL;
     int arglen;
     void *args[6];
+    char codes[SIGNAL_MAX_ARGUMENTS + 1];
 
     memset(args, 0, sizeof args);
 
-    signal = signal_get_emitted();
-    if (!signal)
+    /* from a script handler, the proxy already knows the signal */
+    if (py_dispatch && py_dispatch->proxy->signal_id == signal_get_emitted_id())
     {
-        PyErr_Format(PyExc_LookupError, "cannot determine current signal");
-        return 0;
+        proxy = py_dispatch->proxy;
+        signal = proxy->name;
+        spec = proxy->signal;
+    }
+    else
+    {
+        signal = signal_get_emitted();
+        if (!signal)
+        {
+            PyErr_Format(PyExc_LookupError, "cannot determine current signal");
+            return 0;
+        }
+
+        spec = py_signal_lookup(signal);
+        if (!spec)
+        {
+            PyErr_Format(PyExc_KeyError, "signal not found");
+            return 0;
+        }
     }
    
-    arglen = py_convert_args(args, argtup, signal);
+    arglen = py_convert_args(args, argtup, spec, signal, codes);
     if (arglen < 0)
         return 0;
 
+    /* Script handlers sharing the current proxy are not irssi handlers, so
+     * signal_continue would skip them. Run them first with the new args. 
+     */
+    if (proxy)
+    {
+        GSList *rest = py_dispatch->next;
+
+        py_dispatch->next = NULL;
+        if (rest)
+        {
+            py_proxy_dispatch(proxy, rest, args);
+            if (signal_is_stopped(proxy->signal_id))
+            {
+                py_free_args(args, codes);
+                return 1;
+            }
+        }
+    }
+
     signal_continue(arglen,
             args[0], args[1], args[2],   
             args[3], args[4], args[5]);
 
+    py_free_args(args, codes);
+    return 1;
+}
+
+int pysignals_handle_init(PY_SIGNAL_HANDLE_REC *handle, const char *name)
+{
+    handle->spec = py_signal_lookup(name);
+    if (!handle->spec)
+    {
+        PyErr_Format(PyExc_KeyError, "signal not found");
+        return 0;
+    }
+
+    handle->name = g_strdup(name);
+    handle->signal_id = signal_get_uniq_id(name);
+    handle->generation = py_sig_generation;
+
+    return 1;
+}
+
+void pysignals_handle_deinit(PY_SIGNAL_HANDLE_REC *handle)
+{
+    g_free(handle->name);
+    handle->name = NULL;
+    handle->spec = NULL;
+}
+
+int pysignals_handle_emit(PY_SIGNAL_HANDLE_REC *handle, PyObject *argtup)
+{
+    int arglen;
+    void *args[6];
+    char codes[SIGNAL_MAX_ARGUMENTS + 1];
+
+    g_return_val_if_fail(handle->name != NULL, 0);
+
+    if (handle->generation != py_sig_generation)
+    {
+        handle->spec = py_signal_lookup(handle->name);
+        handle->generation = py_sig_generation;
+    }
+
+    if (!handle->spec)
+    {
+        PyErr_Format(PyExc_KeyError, "signal not found");
+        return 0;
+    }
+
+    memset(args, 0, sizeof args);
+
+    arglen = py_convert_args(args, argtup, handle->spec, handle->name, codes);
+    if (arglen < 0)
+        return 0;
+
+    signal_emit_id(handle->signal_id, arglen,
+            args[0], args[1], args[2],   
+            args[3], args[4], args[5]);
+
+    py_free_args(args, codes);
     return 1;
 }
 
@@ -630,6 +1792,7 @@ static PY_SIGNAL_REC *py_signal_rec_new(const char *signal, PyObject *func, cons
 
     rec = g_new0(PY_SIGNAL_REC, 1);
     rec->signal = spec;
+    rec->argc = -1;
     rec->handler = func;
     Py_INCREF(func);
 
@@ -650,11 +1813,25 @@ static PY_SIGNAL_REC *py_signal_rec_new(const char *signal, PyObject *func, cons
 
     py_signal_ref(spec);
 
+    rec->script = pyloader_find_script_obj();
+    rec->stats = pystats_new(pyloader_find_script_name(), 
+            rec->is_signal? "signal" : "command", SIGNAME(rec));
+
     return rec;
 }
 
 static void py_signal_rec_destroy(PY_SIGNAL_REC *sig)
 {
+    if (sig->filter)
+        py_filter_destroy(sig->filter);
+
+    if (sig->batch_tag)
+        g_source_remove(sig->batch_tag);
+    Py_XDECREF(sig->batch);
+
+    pystats_remove(sig->stats);
+    g_free(sig->category);
+
     py_signal_unref(sig->signal);
     Py_DECREF(sig->handler);
     g_free(sig->command);
@@ -667,6 +1844,9 @@ static void py_signal_add(PY_SIGNAL_SPEC_REC *sig)
         g_tree_insert(py_sigtree, sig->name, sig);
     else
         g_hash_table_insert(py_sighash, sig->name, sig);
+
+    py_sigcache_clear();
+    py_sig_generation++;
 }
 
 static void py_signal_remove(PY_SIGNAL_SPEC_REC *sig)
@@ -680,6 +1860,9 @@ static void py_signal_remove(PY_SIGNAL_SPEC_REC *sig)
         ret = g_hash_table_remove(py_sighash, sig->name);
         g_return_if_fail(ret != FALSE);
     }
+
+    py_sigcache_clear();
+    py_sig_generation++;
 }
 
 static int precmp(const char *spec, const char *test)
@@ -696,15 +1879,43 @@ static int precmp(const char *spec, const char *test)
     return *(const unsigned char *)(test - 1) - *(const unsigned char *)spec; 
 }
 
+static int py_sigcache_drop(char *key, PY_SIGNAL_SPEC_REC *value, void *data)
+{
+    return TRUE;
+}
+
+static void py_sigcache_clear(void)
+{
+    if (py_sigcache)
+        g_hash_table_foreach_remove(py_sigcache, (GHRFunc)py_sigcache_drop, NULL);
+}
+
 static PY_SIGNAL_SPEC_REC *py_signal_lookup(const char *name)
 {
     PY_SIGNAL_SPEC_REC *ret;
 
-    /* First check the normal signals hash, then check the variable signal prefixes in the tree */
-    ret = g_hash_table_lookup(py_sighash, name);
+    /* First check the normal signals, then the variable signal prefixes */
+    ret = py_sigmap_find(name);
+    if (!ret)
+        ret = g_hash_table_lookup(py_sighash, name);
+    if (ret)
+        return ret;
+
+    ret = g_hash_table_lookup(py_sigcache, name);
+    if (ret)
+        return ret;
+
+    ret = py_sigmap_find_prefix(name);
     if (!ret)
         ret = g_tree_search(py_sigtree, (GCompareFunc)precmp, name);
 
+    if (ret)
+    {
+        if (g_hash_table_size(py_sigcache) >= PY_SIGCACHE_MAX)
+            py_sigcache_clear();
+        g_hash_table_insert(py_sigcache, g_strdup(name), ret);
+    }
+
     return ret;
 }
 
@@ -789,12 +2000,13 @@ void pysignals_init(void)
 
     py_sigtree = g_tree_new((GCompareFunc)strcmp);
     py_sighash = g_hash_table_new(g_str_hash, g_str_equal);
+    py_sigcache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
+    /* already in the static tables */
     for (i = 0; i < py_sigmap_len(); i++)
     {
         py_sigmap[i].refcount = 1;
         py_sigmap[i].dynamic = 0;
-        py_signal_add(&py_sigmap[i]);
     }
 }
 
@@ -812,14 +2024,20 @@ static int py_check_sig(char *key, PY_SIGNAL_SPEC_REC *value, void *data)
 /* XXX: remember to remove all scripts before calling this deinit */
 void pysignals_deinit(void)
 {
+    int i;
+
     g_return_if_fail(py_sighash != NULL);
     g_return_if_fail(py_sigtree != NULL);
     
+    for (i = 0; i < py_sigmap_len(); i++)
+        py_check_sig(NULL, &py_sigmap[i], NULL);
     g_tree_foreach(py_sigtree, (GTraverseFunc)py_check_sig, NULL); 
     g_hash_table_foreach_remove(py_sighash, (GHRFunc)py_check_sig, NULL);
 
     g_tree_destroy(py_sigtree);
     g_hash_table_destroy(py_sighash);
+    g_hash_table_destroy(py_sigcache);
     py_sigtree = NULL;
     py_sighash = NULL;
+    py_sigcache = NULL;
 }
@@ -3,16 +3,77 @@
 #include <Python.h>
 
 /* forward */
-struct _PY_SIGNAL_SPEC_REC;
+struct _PY_SIGNAL_PROXY_REC;
+struct _PY_STATS_REC;
+
+/* Name and arg types of a signal known to irssi-python */
+typedef struct _PY_SIGNAL_SPEC_REC 
+{
+    char *name;
+    char *arglist;
+    int refcount;
+    int dynamic;
+    int is_var; /* is this entry a prefix for a variable signal? */
+    GHashTable *proxies; /* PY_SIGNAL_PROXY_REC entries using this spec,
+                          * keyed by exact name and priority */
+} PY_SIGNAL_SPEC_REC;
+
+/* Tested in C before any argument is converted. NULL/0 fields match
+ * anything. The arg positions are worked out by pysignals from the arglist.
+ */
+typedef struct _PY_SIGNAL_FILTER_REC
+{
+    char *tag; /* server tag */
+    char *target; /* channel or query name */
+    char *mask; /* nick!user@host mask */
+    int level; /* MSGLEVEL bits of a TextDest arg */
+
+    int server_arg;
+    int item_arg;
+    int target_arg;
+    int nick_arg;
+    int nick_is_rec;
+    int address_arg;
+    int dest_arg;
+} PY_SIGNAL_FILTER_REC;
 
 typedef struct _PY_SIGNAL_REC
 {
     struct _PY_SIGNAL_SPEC_REC *signal;
     char *command; /* used for command and variable signal */
     PyObject *handler;
+    PyObject *script; /* owner, borrowed */
     int is_signal;
+    int priority;
+    char *category; /* commands only */
+    int suspended; /* unbound from irssi by the watchdog */
+    int lazy; /* nick lists may be passed as LazyList */
+    int parsed; /* called as func(server, IrcMessage) */
+    int argc; /* args the handler accepts, -1 for all */
+    PY_SIGNAL_FILTER_REC *filter; /* NULL when unfiltered */
+    struct _PY_STATS_REC *stats;
+    struct _PY_SIGNAL_PROXY_REC *proxy; /* shared irssi handler, signals only */
+
+    /* batched handlers get a list of arg tuples instead of one call per 
+       signal; batch is NULL for ordinary handlers */
+    PyObject *batch;
+    int batch_size; /* flush when this many are queued */
+    int batch_msecs; /* or this long after the first one */
+    int batch_tag; /* flush source, 0 if none */
 } PY_SIGNAL_REC;
 
+/* A signal name resolved once for repeated emits, see irssi.Signal. The 
+ * spec is looked up again only after signals have been registered or 
+ * removed since the last emit.
+ */
+typedef struct _PY_SIGNAL_HANDLE_REC
+{
+    char *name;
+    int signal_id;
+    struct _PY_SIGNAL_SPEC_REC *spec;
+    unsigned int generation;
+} PY_SIGNAL_HANDLE_REC;
+
 typedef enum
 {
     PSG_COMMAND,
@@ -20,21 +81,42 @@ typedef enum
     PSG_ALL,
 } PSG_TYPE;
 
+/* flags for pysignals_signal_add */
+#define PY_SIGNAL_LAZY 0x01 /* convert only the args func takes */
+#define PY_SIGNAL_PARSED 0x02 /* pass IRC lines as IrcMessage */
+
+/* filter is a template with only tag, target, mask and level set, or NULL.
+ * On a bad filter these return NULL/0 with a Python exception set.
+ */
 PY_SIGNAL_REC *pysignals_command_bind(const char *cmd, PyObject *func, 
-        const char *category, int priority);
+        const char *category, int priority, const PY_SIGNAL_FILTER_REC *filter);
 PY_SIGNAL_REC *pysignals_signal_add(const char *signal, PyObject *func, 
-        int priority);
-int pysignals_command_bind_list(GSList **list, const char *command, 
-        PyObject *func, const char *category, int priority);
-int pysignals_signal_add_list(GSList **list, const char *signal, 
-        PyObject *func, int priority);
+        int priority, int flags, const PY_SIGNAL_FILTER_REC *filter);
+/* Each script keeps its bindings in a table: name -> GSList of 
+ * PY_SIGNAL_REC in bind order, created by the first bind.
+ */
+int pysignals_command_bind_table(GHashTable **table, const char *command, 
+        PyObject *func, const char *category, int priority, 
+        const PY_SIGNAL_FILTER_REC *filter);
+int pysignals_signal_add_table(GHashTable **table, const char *signal, 
+        PyObject *func, int priority, int flags, 
+        const PY_SIGNAL_FILTER_REC *filter);
+int pysignals_signal_add_batched_table(GHashTable **table, const char *signal, 
+        PyObject *func, int priority, int size, int msecs, 
+        const PY_SIGNAL_FILTER_REC *filter);
 void pysignals_command_unbind(PY_SIGNAL_REC *rec);
 void pysignals_signal_remove(PY_SIGNAL_REC *rec);
 void pysignals_remove_generic(PY_SIGNAL_REC *rec);
-int pysignals_remove_search(GSList **siglist, const char *name, 
+int pysignals_remove_search(GHashTable *table, const char *name, 
         PyObject *func, PSG_TYPE type);
-void pysignals_remove_list(GSList *siglist);
+void pysignals_remove_table(GHashTable *table);
+int pysignals_resume_table(GHashTable *table, const char *name);
+void pysignals_suspend(PY_SIGNAL_REC *rec);
+int pysignals_resume(PY_SIGNAL_REC *rec);
 int pysignals_emit(const char *signal, PyObject *argtup);
+int pysignals_handle_init(PY_SIGNAL_HANDLE_REC *handle, const char *name);
+void pysignals_handle_deinit(PY_SIGNAL_HANDLE_REC *handle);
+int pysignals_handle_emit(PY_SIGNAL_HANDLE_REC *handle, PyObject *argtup);
 int pysignals_continue(PyObject *argtup);
 int pysignals_register(const char *name, const char *arglist);
 int pysignals_unregister(const char *name);
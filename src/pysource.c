@@ -19,8 +19,15 @@
 */
 
 #include <Python.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "pyirssi.h"
+#include "pycore.h"
 #include "pysource.h"
+#include "pyloader.h"
+#include "pyscript-object.h"
+#include "pystats.h"
 
 typedef struct _PY_SOURCE_REC
 {
@@ -29,8 +36,21 @@ typedef struct _PY_SOURCE_REC
     int fd;
     PyObject *func;
     PyObject *data;
+    PyObject *script; /* owner, borrowed */
+    PY_STATS_REC *stats;
+
+    /* io_add_reader only, buf is NULL for other sources */
+    GString *buf; /* data after the last whole record */
+    char *delim;
+    int delim_len;
+    int keep_delim; /* records end with their delim */
+    int frame; /* fixed record size, or 0 to split on delim */
+    int max_size; /* longer records are split */
 } PY_SOURCE_REC;
 
+/* bytes read per wakeup, so one busy fd can't starve the main loop */
+#define PY_READER_CHUNK 65536
+
 static PY_SOURCE_REC *py_source_rec_new(GSList **tag_list, int fd, PyObject *func, PyObject *data)
 {
     PY_SOURCE_REC *rec;
@@ -44,6 +64,10 @@ static PY_SOURCE_REC *py_source_rec_new(GSList **tag_list, int fd, PyObject *fun
     Py_INCREF(func);
     Py_XINCREF(data);
 
+    rec->script = pyloader_find_script_obj();
+    rec->stats = pystats_new(pyloader_find_script_name(), 
+            fd < 0? "timeout" : "io", PyEval_GetFuncName(func));
+
     return rec;
 }
 
@@ -60,11 +84,22 @@ static int py_remove_tag(GSList **list, int handle)
     return 1;
 }
 
+/* GLib calls this after a proxy returns FALSE, when the GIL is no longer
+ * held, as well as from source_remove() with it held.
+ */
 static void py_source_destroy(PY_SOURCE_REC *rec)
 {
+    int gil;
+
     g_return_if_fail(py_remove_tag(rec->tag_list, rec->tag) == 1);
+    pystats_remove(rec->stats);
+    gil = python_gil_enter();
     Py_DECREF(rec->func);
     Py_XDECREF(rec->data);
+    python_gil_leave(gil);
+    if (rec->buf)
+        g_string_free(rec->buf, TRUE);
+    g_free(rec->delim);
     g_free(rec);
 }
 
@@ -88,30 +123,194 @@ static int py_handle_ret(PyObject *ret)
 
 static int py_timeout_proxy(PY_SOURCE_REC *rec)
 {
-    PyObject *ret;
+    PyObject *ret, *script;
+    double start;
+    int gil, res;
 
     g_return_val_if_fail(rec != NULL, FALSE);
     
+    gil = python_gil_enter();
+    script = pyloader_enter_script(rec->script);
+    start = pystats_begin(rec->stats);
     if (rec->data)
         ret = PyObject_CallFunction(rec->func, "O", rec->data);
     else
         ret = PyObject_CallFunction(rec->func, "");
+    pystats_end(rec->stats, start, ret != NULL);
+    pyloader_leave_script(script);
+    res = py_handle_ret(ret);
+    python_gil_leave(gil);
 
-    return py_handle_ret(ret);
+    return res;
 }
 
 static int py_io_proxy(GIOChannel *src, GIOCondition condition, PY_SOURCE_REC *rec)
 {
-    PyObject *ret;
+    PyObject *ret, *script;
+    double start;
+    int gil, res;
 
     g_return_val_if_fail(rec != NULL, FALSE);
 
+    gil = python_gil_enter();
+    script = pyloader_enter_script(rec->script);
+    start = pystats_begin(rec->stats);
     if (rec->data)
         ret = PyObject_CallFunction(rec->func, "iiO", rec->fd, condition, rec->data);
     else
         ret = PyObject_CallFunction(rec->func, "ii", rec->fd, condition);
+    pystats_end(rec->stats, start, ret != NULL);
+    pyloader_leave_script(script);
+    res = py_handle_ret(ret);
+    python_gil_leave(gil);
+
+    return res;
+}
+
+static const char *py_memfind(const char *data, int len, const char *needle, int nlen)
+{
+    const char *p = data, *end = data + len;
 
-    return py_handle_ret(ret);
+    while (end - p >= nlen)
+    {
+        p = memchr(p, needle[0], end - p - nlen + 1);
+        if (!p)
+            return NULL;
+        if (memcmp(p, needle, nlen) == 0)
+            return p;
+        p++;
+    }
+
+    return NULL;
+}
+
+/* Take the whole records out of the buffer, and at EOF the rest too */
+static PyObject *py_reader_split(PY_SOURCE_REC *rec, int eof)
+{
+    PyObject *records, *item = NULL;
+    const char *p = rec->buf->str, *end = p + rec->buf->len;
+
+    records = PyList_New(0);
+    if (!records)
+        return NULL;
+
+    for (;;)
+    {
+        const char *stop;
+        int skip = 0;
+
+        if (rec->frame > 0)
+        {
+            if (end - p < rec->frame)
+                break;
+            stop = p + rec->frame;
+        }
+        else
+        {
+            stop = py_memfind(p, end - p, rec->delim, rec->delim_len);
+            if (stop)
+                skip = rec->delim_len;
+            if ((stop && stop - p > rec->max_size) || 
+                    (!stop && end - p >= rec->max_size))
+            {
+                stop = p + rec->max_size;
+                skip = 0;
+            }
+            if (!stop)
+                break;
+        }
+
+        item = PyString_FromStringAndSize(p, 
+                stop - p + (rec->keep_delim? skip : 0));
+        if (!item || PyList_Append(records, item) != 0)
+            goto error;
+        Py_DECREF(item);
+
+        p = stop + skip;
+    }
+
+    if (eof && p < end)
+    {
+        item = PyString_FromStringAndSize(p, end - p);
+        if (!item || PyList_Append(records, item) != 0)
+            goto error;
+        Py_DECREF(item);
+
+        p = end;
+    }
+
+    g_string_erase(rec->buf, 0, p - rec->buf->str);
+    return records;
+
+error:
+    Py_XDECREF(item);
+    Py_DECREF(records);
+    return NULL;
+}
+
+static int py_reader_call(PY_SOURCE_REC *rec, PyObject *records)
+{
+    PyObject *ret;
+
+    if (rec->data)
+        ret = PyObject_CallFunctionObjArgs(rec->func, records, rec->data, NULL);
+    else
+        ret = PyObject_CallFunctionObjArgs(rec->func, records, NULL);
+
+    if (!ret)
+    {
+        PyErr_Print();
+        return FALSE;
+    }
+
+    Py_DECREF(ret);
+    return TRUE;
+}
+
+/* Read once, then pass any whole records to func in one list. At EOF or
+ * on a read error the rest of the buffer is passed as a last record, 
+ * func is called with None and the reader is removed. If the records 
+ * can't be made, func only gets the None.
+ */
+static int py_reader_proxy(GIOChannel *src, GIOCondition condition, PY_SOURCE_REC *rec)
+{
+    PyObject *records, *script;
+    double start;
+    int len, n, gil, eof = FALSE, ok = TRUE;
+
+    g_return_val_if_fail(rec != NULL, FALSE);
+
+    len = rec->buf->len;
+    g_string_set_size(rec->buf, len + PY_READER_CHUNK);
+    n = read(rec->fd, rec->buf->str + len, PY_READER_CHUNK);
+    g_string_truncate(rec->buf, n > 0? len + n : len);
+
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+        return TRUE;
+    if (n <= 0)
+        eof = TRUE;
+
+    gil = python_gil_enter();
+    records = py_reader_split(rec, eof);
+    if (!records)
+    {
+        PyErr_Print();
+        eof = TRUE;
+    }
+
+    script = pyloader_enter_script(rec->script);
+    start = pystats_begin(rec->stats);
+    if (records && PyList_GET_SIZE(records) > 0)
+        ok = py_reader_call(rec, records);
+    if (ok && eof)
+        ok = py_reader_call(rec, Py_None);
+    pystats_end(rec->stats, start, ok);
+    pyloader_leave_script(script);
+
+    Py_XDECREF(records);
+    python_gil_leave(gil);
+
+    return ok && !eof;
 }
 
 int pysource_timeout_add_list(GSList **list, int msecs, PyObject *func, PyObject *data)
@@ -130,6 +329,20 @@ int pysource_timeout_add_list(GSList **list, int msecs, PyObject *func, PyObject
     return rec->tag;
 }
 
+/* Run a C callback once from the main loop, after msecs or when idle if 
+ * msecs is 0. Used to flush work queued during signal dispatch. The 
+ * caller owns the tag and removes it if data goes away first.
+ */
+int pysource_flush_add(int msecs, GSourceFunc func, void *data)
+{
+    g_return_val_if_fail(func != NULL, 0);
+
+    if (msecs <= 0)
+        return g_idle_add(func, data);
+
+    return g_timeout_add(msecs, func, data);
+}
+
 int pysource_io_add_watch_list(GSList **list, int fd, int cond, PyObject *func, PyObject *data)
 {
     PY_SOURCE_REC *rec;
@@ -148,3 +361,182 @@ int pysource_io_add_watch_list(GSList **list, int fd, int cond, PyObject *func,
     
     return rec->tag;
 }
+
+/* delim is used when frame is 0; see py_reader_proxy */
+int pysource_io_add_reader_list(GSList **list, int fd, PyObject *func, PyObject *data,
+        const char *delim, int delim_len, int keep_delim, int frame, int max_size)
+{
+    PY_SOURCE_REC *rec;
+    GIOChannel *channel;
+
+    g_return_val_if_fail(func != NULL, -1);
+    g_return_val_if_fail(frame > 0 || delim_len > 0, -1);
+
+    rec = py_source_rec_new(list, fd, func, data);
+    rec->buf = g_string_sized_new(PY_READER_CHUNK);
+    rec->delim = g_memdup(delim, delim_len);
+    rec->delim_len = delim_len;
+    rec->keep_delim = keep_delim;
+    rec->frame = frame;
+    rec->max_size = max_size > 0? max_size : G_MAXINT;
+
+    channel = g_io_channel_unix_new(fd);
+    rec->tag = g_io_add_watch_full(channel, G_PRIORITY_DEFAULT, 
+            G_IO_IN | G_IO_PRI | G_IO_HUP | G_IO_ERR, 
+            (GIOFunc)py_reader_proxy, rec,
+            (GDestroyNotify)py_source_destroy);
+    g_io_channel_unref(channel);
+   
+    *list = g_slist_append(*list, GINT_TO_POINTER(rec->tag));
+    
+    return rec->tag;
+}
+
+/* Calls posted from other threads with pysource_post(). The queue is a 
+ * list of (script, func, args) tuples guarded by the GIL, which posting
+ * threads hold anyway. The pipe only wakes up the main loop, once for 
+ * each burst of posts.
+ */
+static PyObject *py_posts;
+static int py_post_fds[2] = {-1, -1};
+static int py_post_tag = -1;
+static int py_post_woken;
+
+static void py_post_run(PyObject *post)
+{
+    PyObject *script, *func, *args, *prev, *ret;
+
+    script = PyTuple_GET_ITEM(post, 0);
+    func = PyTuple_GET_ITEM(post, 1);
+    args = PyTuple_GET_ITEM(post, 2);
+
+    if (script == Py_None)
+        script = NULL;
+
+    /* the script was unloaded after posting */
+    if (script && pyloader_find_script(pyscript_get_name(script)) != script)
+        return;
+
+    prev = pyloader_enter_script(script);
+    ret = PyObject_Call(func, args, NULL);
+    if (!ret)
+        PyErr_Print();
+    Py_XDECREF(ret);
+    pyloader_leave_script(prev);
+}
+
+static int py_post_proxy(GIOChannel *src, GIOCondition condition, void *data)
+{
+    PyObject *posts;
+    char buf[64];
+    int i, gil;
+
+    /* no Python code runs until the queue is swapped, so no thread can
+       post in between */
+    gil = python_gil_enter();
+    while (read(py_post_fds[0], buf, sizeof(buf)) > 0)
+        ;
+
+    posts = py_posts;
+    py_posts = PyList_New(0);
+    py_post_woken = FALSE;
+    if (!py_posts)
+    {
+        PyErr_Print();
+        py_posts = posts;
+        python_gil_leave(gil);
+        return TRUE;
+    }
+
+    for (i = 0; i < PyList_GET_SIZE(posts); i++)
+        py_post_run(PyList_GET_ITEM(posts, i));
+
+    Py_DECREF(posts);
+    python_gil_leave(gil);
+    return TRUE;
+}
+
+/* Queue func(*args) to be called from the main loop, in the context of
+ * script (may be NULL). Safe to call from any thread holding the GIL, 
+ * calls run in the order they were posted. Returns FALSE and sets an 
+ * exception on failure.
+ */
+int pysource_post(PyObject *script, PyObject *func, PyObject *args)
+{
+    PyObject *post;
+    int ret;
+
+    g_return_val_if_fail(func != NULL, FALSE);
+    g_return_val_if_fail(args != NULL, FALSE);
+
+    if (!py_posts)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "main loop is not running");
+        return FALSE;
+    }
+
+    post = Py_BuildValue("(OOO)", script? script : Py_None, func, args);
+    if (!post)
+        return FALSE;
+
+    ret = PyList_Append(py_posts, post);
+    Py_DECREF(post);
+    if (ret != 0)
+        return FALSE;
+
+    if (!py_post_woken)
+    {
+        py_post_woken = TRUE;
+        if (write(py_post_fds[1], "", 1) < 0 && errno != EAGAIN)
+            py_post_woken = FALSE;
+    }
+
+    return TRUE;
+}
+
+int pysource_init(void)
+{
+    GIOChannel *channel;
+    int i;
+
+    /* size of the irssi_loop thread pool, whose results come back 
+       through the post queue */
+    settings_add_int("python", "python_executor_threads", 4);
+
+    if (pipe(py_post_fds) != 0)
+        return 0;
+
+    for (i = 0; i < 2; i++)
+    {
+        fcntl(py_post_fds[i], F_SETFL, O_NONBLOCK);
+        fcntl(py_post_fds[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    py_posts = PyList_New(0);
+    if (!py_posts)
+        return 0;
+
+    channel = g_io_channel_unix_new(py_post_fds[0]);
+    py_post_tag = g_io_add_watch(channel, G_IO_IN, (GIOFunc)py_post_proxy, NULL);
+    g_io_channel_unref(channel);
+
+    return 1;
+}
+
+void pysource_deinit(void)
+{
+    int i;
+
+    if (py_post_tag != -1)
+        g_source_remove(py_post_tag);
+    py_post_tag = -1;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (py_post_fds[i] != -1)
+            close(py_post_fds[i]);
+        py_post_fds[i] = -1;
+    }
+
+    Py_CLEAR(py_posts);
+}
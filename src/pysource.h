@@ -6,5 +6,12 @@
 /* condition is G_INPUT_READ or G_INPUT_WRITE */
 int pysource_io_add_watch_list(GSList **list, int fd, int cond, PyObject *func, PyObject *data);
 int pysource_timeout_add_list(GSList **list, int msecs, PyObject *func, PyObject *data);
+int pysource_io_add_reader_list(GSList **list, int fd, PyObject *func, PyObject *data,
+        const char *delim, int delim_len, int keep_delim, int frame, int max_size);
+int pysource_flush_add(int msecs, GSourceFunc func, void *data);
+int pysource_post(PyObject *script, PyObject *func, PyObject *args);
+
+int pysource_init(void);
+void pysource_deinit(void);
 
 #endif
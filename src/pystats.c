@@ -0,0 +1,403 @@
+/* 
+    irssi-python
+
+    Copyright (C) 2006 Christopher Davis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <Python.h>
+#include <time.h>
+#include "pyirssi.h"
+#include "pystats.h"
+
+/* NOTE:
+ * Each handler record (PY_SIGNAL_REC, PY_SOURCE_REC, PY_BAR_ITEM_REC) owns a
+ * PY_STATS_REC that stays in the stats table until the handler is removed.
+ * A handler can remove itself while it runs, so pystats_begin holds a 
+ * reference until pystats_end has stored the timing. When stats and the 
+ * watchdog are both off, pystats_begin returns 0 and neither call does 
+ * anything else.
+ *
+ * The watchdog compares each call against python_handler_budget and the
+ * script's time in the current second against python_script_budget. After
+ * python_slow_count overruns in a row it warns once per handler, and 
+ * pystats_end returns TRUE if python_suspend_slow is set, so the caller 
+ * can suspend the binding.
+ */
+
+int pystats_enabled = 1;
+
+/* Set of live PY_STATS_REC entries */
+static GHashTable *py_stats = NULL;
+
+typedef struct
+{
+    double window; /* start of the current second */
+    double used;
+} PY_SCRIPT_TIME_REC;
+
+/* Map: script name -> PY_SCRIPT_TIME_REC */
+static GHashTable *py_script_times = NULL;
+
+/* watchdog settings, budgets in seconds, 0 is off */
+static double py_handler_budget = 0;
+static double py_script_budget = 0;
+static int py_slow_count = 3;
+static int py_suspend_slow = FALSE;
+
+/* PY_STARTUP_REC list in start order; filled from before pystats_init */
+static GSList *py_startup = NULL;
+static int py_startup_depth = 0;
+
+#define py_watchdog_on() (py_handler_budget > 0 || py_script_budget > 0)
+
+/* monotonic seconds */
+double pystats_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+    {
+        GTimeVal tv;
+
+        g_get_current_time(&tv);
+        return tv.tv_sec + tv.tv_usec / 1e6;
+    }
+}
+
+static void py_stats_unref(PY_STATS_REC *rec)
+{
+    g_return_if_fail(rec->refcount > 0);
+
+    if (--rec->refcount > 0)
+        return;
+
+    g_free(rec->script);
+    g_free(rec->name);
+    g_free(rec);
+}
+
+PY_STATS_REC *pystats_new(const char *script, const char *type, const char *name)
+{
+    PY_STATS_REC *rec;
+
+    g_return_val_if_fail(py_stats != NULL, NULL);
+
+    rec = g_new0(PY_STATS_REC, 1);
+    rec->script = g_strdup(script? script : "?");
+    rec->type = type;
+    rec->name = g_strdup(name);
+    rec->refcount = 1;
+    rec->live = TRUE;
+
+    g_hash_table_insert(py_stats, rec, rec);
+
+    return rec;
+}
+
+void pystats_remove(PY_STATS_REC *rec)
+{
+    if (!rec)
+        return;
+
+    rec->live = FALSE;
+    g_hash_table_remove(py_stats, rec);
+    py_stats_unref(rec);
+}
+
+/* returns the start time, or 0 if nothing is to be recorded */
+double pystats_begin(PY_STATS_REC *rec)
+{
+    if (!rec || !(pystats_enabled || py_watchdog_on()))
+        return 0;
+
+    rec->refcount++;
+    return pystats_now();
+}
+
+static int py_stats_watch(PY_STATS_REC *rec, double now, double elapsed)
+{
+    int over = FALSE;
+
+    if (py_handler_budget > 0 && elapsed > py_handler_budget)
+        over = TRUE;
+
+    if (py_script_budget > 0)
+    {
+        PY_SCRIPT_TIME_REC *st;
+
+        st = g_hash_table_lookup(py_script_times, rec->script);
+        if (!st)
+        {
+            st = g_new0(PY_SCRIPT_TIME_REC, 1);
+            g_hash_table_insert(py_script_times, g_strdup(rec->script), st);
+        }
+
+        if (now - st->window >= 1.0)
+        {
+            st->window = now;
+            st->used = 0;
+        }
+
+        st->used += elapsed;
+        if (st->used > py_script_budget)
+            over = TRUE;
+    }
+
+    if (!over)
+    {
+        rec->overruns = 0;
+        return FALSE;
+    }
+
+    if (++rec->overruns < py_slow_count)
+        return FALSE;
+
+    if (!rec->warned)
+    {
+        rec->warned = TRUE;
+        printtext(NULL, NULL, MSGLEVEL_CLIENTERROR, 
+                "Python script %s: %s handler `%s' is slow (%.0f ms)",
+                rec->script, rec->type, rec->name, elapsed * 1e3);
+    }
+
+    return py_suspend_slow && rec->live;
+}
+
+/* returns TRUE if the handler should be suspended */
+int pystats_end(PY_STATS_REC *rec, double start, int ok)
+{
+    double now, elapsed;
+    int suspend = FALSE;
+
+    if (start == 0)
+        return FALSE;
+
+    now = pystats_now();
+    elapsed = now - start;
+
+    if (pystats_enabled)
+    {
+        rec->calls++;
+        if (!ok)
+            rec->errors++;
+        rec->total += elapsed;
+        if (elapsed > rec->max)
+            rec->max = elapsed;
+    }
+
+    if (py_watchdog_on())
+        suspend = py_stats_watch(rec, now, elapsed);
+
+    py_stats_unref(rec);
+    return suspend;
+}
+
+static void py_stats_collect(PY_STATS_REC *key, PY_STATS_REC *rec, GSList **list)
+{
+    rec->refcount++;
+    *list = g_slist_prepend(*list, rec);
+}
+
+static int py_stats_cmp(PY_STATS_REC *a, PY_STATS_REC *b)
+{
+    if (a->total > b->total)
+        return -1;
+    if (a->total < b->total)
+        return 1;
+    return 0;
+}
+
+/* returns all entries, most expensive first. free with pystats_list_destroy */
+GSList *pystats_list(void)
+{
+    GSList *list = NULL;
+
+    g_return_val_if_fail(py_stats != NULL, NULL);
+
+    g_hash_table_foreach(py_stats, (GHFunc)py_stats_collect, &list);
+    return g_slist_sort(list, (GCompareFunc)py_stats_cmp);
+}
+
+void pystats_list_destroy(GSList *list)
+{
+    g_slist_foreach(list, (GFunc)py_stats_unref, NULL);
+    g_slist_free(list);
+}
+
+static void py_stats_clear(PY_STATS_REC *key, PY_STATS_REC *rec, void *data)
+{
+    rec->calls = 0;
+    rec->errors = 0;
+    rec->total = 0;
+    rec->max = 0;
+    rec->overruns = 0;
+    rec->warned = FALSE;
+}
+
+void pystats_reset(void)
+{
+    g_return_if_fail(py_stats != NULL);
+
+    g_hash_table_foreach(py_stats, (GHFunc)py_stats_clear, NULL);
+}
+
+/* returns {script: [{type, name, calls, errors, total, max}, ...]} */
+PyObject *pystats_dict(void)
+{
+    PyObject *dict;
+    GSList *list, *node;
+
+    dict = PyDict_New();
+    if (!dict)
+        return NULL;
+
+    list = pystats_list();
+    for (node = list; node != NULL; node = node->next)
+    {
+        PY_STATS_REC *rec = node->data;
+        PyObject *entry, *entries;
+
+        entries = PyDict_GetItemString(dict, rec->script);
+        if (!entries)
+        {
+            entries = PyList_New(0);
+            if (!entries)
+                goto error;
+
+            if (PyDict_SetItemString(dict, rec->script, entries) < 0)
+            {
+                Py_DECREF(entries);
+                goto error;
+            }
+            Py_DECREF(entries);
+        }
+
+        entry = Py_BuildValue("{s:s,s:s,s:k,s:k,s:d,s:d}",
+                "type", rec->type,
+                "name", rec->name,
+                "calls", rec->calls,
+                "errors", rec->errors,
+                "total", rec->total,
+                "max", rec->max);
+        if (!entry)
+            goto error;
+
+        if (PyList_Append(entries, entry) < 0)
+        {
+            Py_DECREF(entry);
+            goto error;
+        }
+        Py_DECREF(entry);
+    }
+
+    pystats_list_destroy(list);
+    return dict;
+
+error:
+    pystats_list_destroy(list);
+    Py_DECREF(dict);
+    return NULL;
+}
+
+/* Start timing a startup step; end it with pystats_startup_end */
+PY_STARTUP_REC *pystats_startup_begin(const char *name)
+{
+    PY_STARTUP_REC *rec;
+
+    rec = g_new0(PY_STARTUP_REC, 1);
+    rec->name = g_strdup(name);
+    rec->depth = py_startup_depth++;
+    rec->secs = pystats_now();
+    py_startup = g_slist_append(py_startup, rec);
+
+    return rec;
+}
+
+void pystats_startup_end(PY_STARTUP_REC *rec)
+{
+    rec->secs = pystats_now() - rec->secs;
+    py_startup_depth = rec->depth;
+}
+
+/* Time an init function as a startup step */
+int pystats_startup_call(const char *name, int (*func)(void))
+{
+    PY_STARTUP_REC *rec = pystats_startup_begin(name);
+    int ret = func();
+
+    pystats_startup_end(rec);
+    return ret;
+}
+
+/* borrowed list of PY_STARTUP_REC */
+GSList *pystats_startup_list(void)
+{
+    return py_startup;
+}
+
+static void read_settings(void)
+{
+    py_handler_budget = settings_get_time("python_handler_budget") / 1000.0;
+    py_script_budget = settings_get_time("python_script_budget") / 1000.0;
+    py_slow_count = settings_get_int("python_slow_count");
+    py_suspend_slow = settings_get_bool("python_suspend_slow");
+}
+
+void pystats_init(void)
+{
+    g_return_if_fail(py_stats == NULL);
+
+    py_stats = g_hash_table_new(g_direct_hash, g_direct_equal);
+    py_script_times = g_hash_table_new_full(g_str_hash, g_str_equal, 
+            g_free, g_free);
+
+    settings_add_time("python", "python_handler_budget", "500ms");
+    settings_add_time("python", "python_script_budget", "0");
+    settings_add_int("python", "python_slow_count", 3);
+    settings_add_bool("python", "python_suspend_slow", FALSE);
+    read_settings();
+
+    signal_add("setup changed", (SIGNAL_FUNC) read_settings);
+}
+
+void pystats_deinit(void)
+{
+    GSList *node;
+
+    g_return_if_fail(py_stats != NULL);
+
+    signal_remove("setup changed", (SIGNAL_FUNC) read_settings);
+
+    g_hash_table_destroy(py_script_times);
+    g_hash_table_destroy(py_stats);
+    py_script_times = NULL;
+    py_stats = NULL;
+
+    for (node = py_startup; node != NULL; node = node->next)
+    {
+        PY_STARTUP_REC *rec = node->data;
+
+        g_free(rec->name);
+        g_free(rec);
+    }
+    g_slist_free(py_startup);
+    py_startup = NULL;
+    py_startup_depth = 0;
+}
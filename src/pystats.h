@@ -0,0 +1,55 @@
+#ifndef _PYSTATS_H_
+#define _PYSTATS_H_
+
+#include <Python.h>
+#include <glib.h>
+
+/* Call counts and timings for one handler: a bound signal or command, a 
+ * timeout or io source, or a statusbar item.
+ */
+typedef struct _PY_STATS_REC
+{
+    char *script;
+    const char *type; /* "signal", "command", "timeout", "io", "statusbar" */
+    char *name;
+    int refcount;
+
+    unsigned long calls;
+    unsigned long errors;
+    double total; /* seconds */
+    double max;
+
+    int live; /* owner still exists */
+    int overruns; /* calls over budget in a row */
+    int warned;
+} PY_STATS_REC;
+
+/* One timed step of python_init. Steps started inside another step get a
+ * greater depth and follow it in the list.
+ */
+typedef struct
+{
+    char *name;
+    int depth;
+    double secs;
+} PY_STARTUP_REC;
+
+extern int pystats_enabled;
+
+PY_STATS_REC *pystats_new(const char *script, const char *type, const char *name);
+void pystats_remove(PY_STATS_REC *rec);
+double pystats_now(void);
+double pystats_begin(PY_STATS_REC *rec);
+int pystats_end(PY_STATS_REC *rec, double start, int ok);
+GSList *pystats_list(void);
+void pystats_list_destroy(GSList *list);
+void pystats_reset(void);
+PyObject *pystats_dict(void);
+PY_STARTUP_REC *pystats_startup_begin(const char *name);
+void pystats_startup_end(PY_STARTUP_REC *rec);
+int pystats_startup_call(const char *name, int (*func)(void));
+GSList *pystats_startup_list(void);
+void pystats_init(void);
+void pystats_deinit(void);
+
+#endif
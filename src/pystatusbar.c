@@ -20,6 +20,9 @@
 
 #include "pystatusbar.h"
 #include "pyirssi.h"
+#include "pycore.h"
+#include "pystats.h"
+#include "pyloader.h"
 #include "factory.h"
 
 typedef struct
@@ -27,6 +30,7 @@ typedef struct
     char *name;
     PyObject *script;
     PyObject *handler;
+    PY_STATS_REC *stats;
 } PY_BAR_ITEM_REC;
 
 /* Map: item name -> bar item obj */
@@ -42,6 +46,7 @@ static void py_add_bar_handler(const char *iname, PyObject *script, PyObject *ha
     sitem->handler = handler;
     Py_INCREF(script);
     Py_INCREF(handler);
+    sitem->stats = pystats_new(pyscript_get_name(script), "statusbar", iname);
 
     g_hash_table_insert(py_bar_items, sitem->name, sitem);
 }
@@ -50,6 +55,7 @@ static void py_destroy_handler(PY_BAR_ITEM_REC *sitem)
 {
     statusbar_item_unregister(sitem->name);
 
+    pystats_remove(sitem->stats);
     g_free(sitem->name); /* destroy key */
     Py_DECREF(sitem->script);
     Py_DECREF(sitem->handler);
@@ -58,19 +64,28 @@ static void py_destroy_handler(PY_BAR_ITEM_REC *sitem)
 
 static void py_statusbar_proxy_call(SBAR_ITEM_REC *item, int sizeonly, PY_BAR_ITEM_REC *sitem)
 {
+    PY_STATS_REC *stats = sitem->stats;
     PyObject *pybaritem;
-    PyObject *ret;
+    PyObject *ret, *script;
+    double start;
 
     g_return_if_fail(PyCallable_Check(sitem->handler));
 
+    /* sitem is gone if the handler fails and gets unregistered */
+    start = pystats_begin(stats);
+
     pybaritem = pystatusbar_item_new(item);
     if (!pybaritem)
     {
         PyErr_Print();
         pystatusbar_item_unregister(sitem->name);
+        pystats_end(stats, start, FALSE);
+        return;
     }
 
+    script = pyloader_enter_script(sitem->script);
     ret = PyObject_CallFunction(sitem->handler, "Oi", pybaritem, sizeonly);
+    Py_DECREF(pybaritem);
     if (!ret)
     {
         PyErr_Print();
@@ -78,15 +93,23 @@ static void py_statusbar_proxy_call(SBAR_ITEM_REC *item, int sizeonly, PY_BAR_IT
     }
     else
         Py_DECREF(ret);
+    pyloader_leave_script(script);
+
+    pystats_end(stats, start, ret != NULL);
 }
 
 static void py_statusbar_proxy(SBAR_ITEM_REC *item, int sizeonly)
 {
     PY_BAR_ITEM_REC *sitem;    
+    int gil;
 
     sitem = g_hash_table_lookup(py_bar_items, item->config->name);
     if (sitem)
+    {
+        gil = python_gil_enter();
         py_statusbar_proxy_call(item, sizeonly, sitem);
+        python_gil_leave(gil);
+    }
     else
     {
         statusbar_item_default_handler(item, sizeonly, NULL, "", TRUE);
@@ -0,0 +1,327 @@
+/* 
+    irssi-python
+
+    Copyright (C) 2006 Christopher Davis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <Python.h>
+#include "pyirssi.h"
+#include "pycore.h"
+#include "pytimer.h"
+#include "pystats.h"
+
+/* NOTE:
+ * Timers live on a hierarchical wheel with one millisecond ticks. Level 0
+ * has a slot for each of the next 64 ticks, level 1 a slot for each of the
+ * next 64 runs of 64 ticks, and so on. A timer goes into the lowest level
+ * whose range covers it, and when the wheel reaches the start of a higher
+ * level slot its timers are spread out over the levels below. Adding and
+ * cancelling are O(1), since each slot is a doubly linked list.
+ *
+ * One GSource drives the wheel. py_wheel_next is never later than the
+ * next slot that has work, so the source sleeps until then and the empty
+ * ticks in between are skipped.
+ */
+#define PY_WHEEL_BITS 6
+#define PY_WHEEL_SIZE (1 << PY_WHEEL_BITS)
+#define PY_WHEEL_MASK (PY_WHEEL_SIZE - 1)
+#define PY_WHEEL_LEVELS 5
+#define PY_WHEEL_SPAN ((guint64)1 << (PY_WHEEL_BITS * PY_WHEEL_LEVELS))
+#define PY_WHEEL_NEVER ((guint64)-1)
+
+#define py_wheel_shift(level) (PY_WHEEL_BITS * (level))
+
+static PY_TIMER_LINK py_wheel[PY_WHEEL_LEVELS][PY_WHEEL_SIZE];
+static guint64 py_wheel_tick = 0; /* last tick run */
+static guint64 py_wheel_next = PY_WHEEL_NEVER;
+static double py_wheel_base = 0; /* pystats_now() at tick 0 */
+static int py_wheel_count = 0;
+static GSource *py_wheel_source = NULL;
+
+static guint64 py_wheel_now(void)
+{
+    return (guint64)((pystats_now() - py_wheel_base) * 1000.0);
+}
+
+static void py_link_add(PY_TIMER_LINK *head, PY_TIMER_LINK *link)
+{
+    link->prev = head->prev;
+    link->next = head;
+    head->prev->next = link;
+    head->prev = link;
+}
+
+static void py_link_del(PY_TIMER_LINK *link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->prev = link->next = NULL;
+}
+
+/* the tick due is in the past for a cascade or a late repeat */
+static void py_wheel_insert(PY_TIMER_REC *timer, guint64 due)
+{
+    guint64 delta, start;
+    int level = 0;
+
+    if (due < py_wheel_tick)
+        due = py_wheel_tick;
+
+    delta = due - py_wheel_tick;
+    if (delta >= PY_WHEEL_SPAN)
+        due = py_wheel_tick + PY_WHEEL_SPAN - 1; /* comes back on cascade */
+
+    while (level < PY_WHEEL_LEVELS - 1 && 
+            delta >= ((guint64)1 << py_wheel_shift(level + 1)))
+        level++;
+
+    py_link_add(&py_wheel[level][(due >> py_wheel_shift(level)) & PY_WHEEL_MASK], 
+            &timer->link);
+
+    /* when the slot is reached */
+    start = (due >> py_wheel_shift(level)) << py_wheel_shift(level);
+    if (start < py_wheel_next)
+        py_wheel_next = start;
+}
+
+/* target plus coalescing; timers with a tolerance are moved to the next 
+   tick that is a multiple of the largest power of 2 not above it */
+static guint64 py_timer_due(PY_TIMER_REC *timer)
+{
+    guint64 due = timer->target, grain = 1;
+
+    while (grain * 2 <= (guint64)timer->tolerance)
+        grain *= 2;
+
+    return (due + grain - 1) & ~(grain - 1);
+}
+
+static void py_wheel_cascade(int level, int slot)
+{
+    PY_TIMER_LINK *head = &py_wheel[level][slot];
+    PY_TIMER_LINK list;
+
+    if (head->next == head)
+        return;
+
+    /* move the slot's timers aside, some may land in it again */
+    list.next = head->next;
+    list.prev = head->prev;
+    list.next->prev = &list;
+    list.prev->next = &list;
+    head->next = head->prev = head;
+
+    while (list.next != &list)
+    {
+        PY_TIMER_REC *timer = (PY_TIMER_REC *)list.next;
+
+        py_link_del(&timer->link);
+        py_wheel_insert(timer, py_timer_due(timer));
+    }
+}
+
+static void py_wheel_find_next(void)
+{
+    int level, k;
+
+    py_wheel_next = PY_WHEEL_NEVER;
+    if (py_wheel_count == 0)
+        return;
+
+    for (level = 0; level < PY_WHEEL_LEVELS; level++)
+    {
+        guint64 base = py_wheel_tick >> py_wheel_shift(level);
+
+        for (k = 1; k <= PY_WHEEL_SIZE; k++)
+        {
+            PY_TIMER_LINK *head = &py_wheel[level][(base + k) & PY_WHEEL_MASK];
+
+            if (head->next != head)
+            {
+                guint64 start = (base + k) << py_wheel_shift(level);
+
+                if (start < py_wheel_next)
+                    py_wheel_next = start;
+                break;
+            }
+        }
+    }
+}
+
+static void py_wheel_run(guint64 now)
+{
+    while (py_wheel_tick < now)
+    {
+        PY_TIMER_LINK *head;
+        int level, idx;
+
+        if (py_wheel_next > now)
+        {
+            py_wheel_tick = now;
+            break;
+        }
+
+        /* nothing to do before py_wheel_next */
+        if (py_wheel_next > py_wheel_tick + 1)
+            py_wheel_tick = py_wheel_next - 1;
+
+        py_wheel_tick++;
+
+        idx = py_wheel_tick & PY_WHEEL_MASK;
+        for (level = 1; idx == 0 && level < PY_WHEEL_LEVELS; level++)
+        {
+            idx = (py_wheel_tick >> py_wheel_shift(level)) & PY_WHEEL_MASK;
+            py_wheel_cascade(level, idx);
+        }
+
+        head = &py_wheel[0][py_wheel_tick & PY_WHEEL_MASK];
+        while (head->next != head)
+        {
+            PY_TIMER_REC *timer = (PY_TIMER_REC *)head->next;
+
+            py_link_del(&timer->link);
+            py_wheel_count--;
+
+            /* add repeating timers back first, so func can cancel them */
+            if (timer->repeat)
+            {
+                timer->target += timer->msecs;
+                if (timer->target <= py_wheel_tick)
+                    timer->target = py_wheel_tick + 1;
+                py_wheel_insert(timer, py_timer_due(timer));
+                py_wheel_count++;
+            }
+
+            /* timer may be freed by func */
+            timer->func(timer);
+        }
+
+        if (py_wheel_next <= py_wheel_tick)
+            py_wheel_find_next();
+    }
+}
+
+static gboolean py_wheel_prepare(GSource *source, gint *timeout)
+{
+    guint64 now;
+
+    if (py_wheel_count == 0)
+    {
+        *timeout = -1;
+        return FALSE;
+    }
+
+    now = py_wheel_now();
+    if (py_wheel_next <= now)
+    {
+        *timeout = 0;
+        return TRUE;
+    }
+
+    *timeout = py_wheel_next - now > G_MAXINT? G_MAXINT : (gint)(py_wheel_next - now);
+    return FALSE;
+}
+
+static gboolean py_wheel_check(GSource *source)
+{
+    return py_wheel_count > 0 && py_wheel_next <= py_wheel_now();
+}
+
+static gboolean py_wheel_dispatch(GSource *source, GSourceFunc callback, gpointer data)
+{
+    int gil;
+
+    gil = python_gil_enter();
+    py_wheel_run(py_wheel_now());
+    python_gil_leave(gil);
+    return TRUE;
+}
+
+static GSourceFuncs py_wheel_funcs = {
+    py_wheel_prepare,
+    py_wheel_check,
+    py_wheel_dispatch,
+    NULL
+};
+
+/* Start timer, due msecs from now */
+void pytimer_add(PY_TIMER_REC *timer)
+{
+    guint64 now;
+
+    g_return_if_fail(timer != NULL);
+    g_return_if_fail(timer->func != NULL);
+    g_return_if_fail(!pytimer_pending(timer));
+
+    now = py_wheel_now();
+    if (now < py_wheel_tick)
+        now = py_wheel_tick;
+
+    /* the tick being run is done, so it's at least the next one */
+    timer->target = now + (timer->msecs > 0? timer->msecs : 1);
+    py_wheel_insert(timer, py_timer_due(timer));
+    py_wheel_count++;
+}
+
+void pytimer_cancel(PY_TIMER_REC *timer)
+{
+    g_return_if_fail(timer != NULL);
+
+    if (!pytimer_pending(timer))
+        return;
+
+    /* py_wheel_next stays; waking up early is harmless */
+    py_link_del(&timer->link);
+    py_wheel_count--;
+}
+
+/* number of pending timers */
+int pytimer_count(void)
+{
+    return py_wheel_count;
+}
+
+void pytimer_init(void)
+{
+    int level, slot;
+
+    g_return_if_fail(py_wheel_source == NULL);
+
+    for (level = 0; level < PY_WHEEL_LEVELS; level++)
+    {
+        for (slot = 0; slot < PY_WHEEL_SIZE; slot++)
+            py_wheel[level][slot].prev = py_wheel[level][slot].next = &py_wheel[level][slot];
+    }
+
+    py_wheel_base = pystats_now();
+    py_wheel_tick = 0;
+    py_wheel_next = PY_WHEEL_NEVER;
+    py_wheel_count = 0;
+
+    py_wheel_source = g_source_new(&py_wheel_funcs, sizeof(GSource));
+    g_source_attach(py_wheel_source, NULL);
+}
+
+void pytimer_deinit(void)
+{
+    g_return_if_fail(py_wheel_source != NULL);
+
+    /* scripts have cancelled their timers by now */
+    g_source_destroy(py_wheel_source);
+    g_source_unref(py_wheel_source);
+    py_wheel_source = NULL;
+}
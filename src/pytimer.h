@@ -0,0 +1,37 @@
+#ifndef _PYTIMER_H_
+#define _PYTIMER_H_
+
+#include <glib.h>
+
+typedef struct _PY_TIMER_LINK
+{
+    struct _PY_TIMER_LINK *prev, *next;
+} PY_TIMER_LINK;
+
+typedef struct _PY_TIMER_REC PY_TIMER_REC;
+typedef void (*PY_TIMER_FUNC)(PY_TIMER_REC *timer);
+
+/* A timer on the wheel. The owner fills in everything from msecs down 
+ * and must cancel a pending timer before freeing it.
+ */
+struct _PY_TIMER_REC
+{
+    PY_TIMER_LINK link; /* next is NULL when not pending */
+    guint64 target; /* tick it was due, before coalescing */
+
+    int msecs;
+    int tolerance; /* msecs it may fire late to share a tick with others */
+    int repeat; /* add again for msecs later before each call */
+    PY_TIMER_FUNC func;
+    void *data;
+};
+
+#define pytimer_pending(timer) ((timer)->link.next != NULL)
+
+void pytimer_add(PY_TIMER_REC *timer);
+void pytimer_cancel(PY_TIMER_REC *timer);
+int pytimer_count(void);
+void pytimer_init(void);
+void pytimer_deinit(void);
+
+#endif
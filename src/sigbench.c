@@ -0,0 +1,145 @@
+/* 
+    irssi-python
+
+    Copyright (C) 2006 Christopher Davis
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Times signal lookups over every built-in signal with the static tables 
+ * from pysighash.h and with the GHashTable/GTree pair pysignals.c used
+ * before, and checks that both agree. Not installed; build it with 
+ * "make sigbench" and run ./sigbench [rounds].
+ */
+
+#include <Python.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include "pysignals.h"
+#include "pysigmap.h"
+#include "pysighash.h"
+
+static int precmp(const char *spec, const char *test)
+{
+    while (*spec == *test++)
+        if (*spec++ == '\0')
+            return 0;
+
+    if (*spec == '\0' && *(spec-1) == ' ')
+        return 0;
+    
+    return *(const unsigned char *)(test - 1) - *(const unsigned char *)spec; 
+}
+
+static PY_SIGNAL_SPEC_REC *glib_lookup(GHashTable *hash, GTree *tree, const char *name)
+{
+    PY_SIGNAL_SPEC_REC *ret;
+
+    ret = g_hash_table_lookup(hash, name);
+    if (!ret)
+        ret = g_tree_search(tree, (GCompareFunc)precmp, name);
+
+    return ret;
+}
+
+static PY_SIGNAL_SPEC_REC *static_lookup(const char *name)
+{
+    PY_SIGNAL_SPEC_REC *ret;
+
+    ret = py_sigmap_find(name);
+    if (!ret)
+        ret = py_sigmap_find_prefix(name);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    GHashTable *hash;
+    GTree *tree;
+    GTimer *timer;
+    char **names;
+    int rounds = 10000;
+    int count, i, r, bad = 0;
+    double t_glib, t_static;
+    void *sink = NULL;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+
+    hash = g_hash_table_new(g_str_hash, g_str_equal);
+    tree = g_tree_new((GCompareFunc)strcmp);
+    names = g_new0(char *, py_sigmap_len() + 1);
+
+    /* variable signals are looked up with a suffix, as when emitted */
+    for (i = count = 0; i < py_sigmap_len(); i++)
+    {
+        PY_SIGNAL_SPEC_REC *spec = &py_sigmap[i];
+
+        if (spec->is_var)
+        {
+            g_tree_insert(tree, spec->name, spec);
+            names[count++] = g_strconcat(spec->name, "352", NULL);
+        }
+        else
+        {
+            g_hash_table_insert(hash, spec->name, spec);
+            names[count++] = g_strdup(spec->name);
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        PY_SIGNAL_SPEC_REC *a = glib_lookup(hash, tree, names[i]);
+        PY_SIGNAL_SPEC_REC *b = static_lookup(names[i]);
+
+        if (!a || !b || strcmp(a->name, b->name) != 0)
+        {
+            fprintf(stderr, "mismatch for `%s'\n", names[i]);
+            bad++;
+        }
+    }
+
+    if (static_lookup("no such signal") || static_lookup("even 352"))
+    {
+        fprintf(stderr, "unknown signal found\n");
+        bad++;
+    }
+
+    timer = g_timer_new();
+    for (r = 0; r < rounds; r++)
+        for (i = 0; i < count; i++)
+            sink = glib_lookup(hash, tree, names[i]);
+    t_glib = g_timer_elapsed(timer, NULL);
+
+    g_timer_start(timer);
+    for (r = 0; r < rounds; r++)
+        for (i = 0; i < count; i++)
+            sink = static_lookup(names[i]);
+    t_static = g_timer_elapsed(timer, NULL);
+
+    printf("%d signals, %d rounds\n", count, rounds);
+    printf("%-8s %8.1f ns/lookup\n", "glib", t_glib * 1e9 / ((double)rounds * count));
+    printf("%-8s %8.1f ns/lookup\n", "static", t_static * 1e9 / ((double)rounds * count));
+
+    g_timer_destroy(timer);
+    g_strfreev(names);
+    g_tree_destroy(tree);
+    g_hash_table_destroy(hash);
+
+    return bad? 1 : (sink == NULL);
+}
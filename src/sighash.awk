@@ -0,0 +1,208 @@
+# Reads pysigmap.h and writes lookup tables for the built-in signals:
+# a two level perfect hash for the plain signals and a sorted table for
+# the variable signal prefixes. Both hold indexes into py_sigmap.
+#
+# The hash of a string for multiplier m is h = h * m + c mod 2^32, the same
+# as py_sighash_str in pysignals.c. A signal goes in bucket 
+# hash(31) % PY_SIGHASH_BUCKETS, and in slot hash(31 + 2 * disp) % 
+# PY_SIGHASH_SIZE, where disp is the first displacement found for the 
+# bucket that puts all its signals in empty slots.
+
+BEGIN {
+    FS = "\"";
+    n = 0;
+    nvar = 0;
+
+    for (i = 1; i < 128; i++)
+        ord[sprintf("%c", i)] = i;
+}
+
+function strhash(s, m,    h, i)
+{
+    h = 0;
+    for (i = 1; i <= length(s); i++)
+        h = (h * m + ord[substr(s, i, 1)]) % 4294967296;
+
+    return h;
+}
+
+function isprime(x,    i)
+{
+    if (x < 2)
+        return 0;
+    for (i = 2; i * i <= x; i++)
+        if (x % i == 0)
+            return 0;
+    return 1;
+}
+
+/^    \{"/ {
+    name = $2;
+    idx = NR_ENTRY++;
+
+    # first entry wins, as it did in the old hash table
+    if (name in seen)
+        next;
+    seen[name] = 1;
+
+    if ($0 ~ /1\},$/)
+        varsig[nvar++] = idx;
+    else
+    {
+        keys[n] = name;
+        keyidx[n] = idx;
+        n++;
+    }
+
+    names[idx] = name;
+}
+
+END {
+    size = int(n * 5 / 4) + 1;
+    while (!isprime(size))
+        size++;
+    buckets = int(n / 4) + 1;
+
+    for (b = 0; b < buckets; b++)
+        bsize[b] = 0;
+
+    for (k = 0; k < n; k++)
+    {
+        b = strhash(keys[k], 31) % buckets;
+        bkeys[b, bsize[b]++] = k;
+    }
+
+    # biggest buckets first
+    for (b = 0; b < buckets; b++)
+        order[b] = b;
+    for (i = 1; i < buckets; i++)
+    {
+        v = order[i];
+        for (j = i - 1; j >= 0 && bsize[order[j]] < bsize[v]; j--)
+            order[j + 1] = order[j];
+        order[j + 1] = v;
+    }
+
+    for (s = 0; s < size; s++)
+        slot[s] = -1;
+
+    for (i = 0; i < buckets; i++)
+    {
+        b = order[i];
+        disp[b] = 0;
+        if (bsize[b] == 0)
+            continue;
+
+        for (d = 1; ; d++)
+        {
+            ok = 1;
+            for (j = 0; j < bsize[b] && ok; j++)
+            {
+                try[j] = strhash(keys[bkeys[b, j]], 31 + 2 * d) % size;
+                if (slot[try[j]] != -1)
+                    ok = 0;
+                for (l = 0; l < j && ok; l++)
+                    if (try[l] == try[j])
+                        ok = 0;
+            }
+
+            if (ok)
+                break;
+        }
+
+        disp[b] = d;
+        for (j = 0; j < bsize[b]; j++)
+            slot[try[j]] = keyidx[bkeys[b, j]];
+    }
+
+    # sort prefixes by name for binary search
+    for (i = 1; i < nvar; i++)
+    {
+        v = varsig[i];
+        for (j = i - 1; j >= 0 && names[varsig[j]] > names[v]; j--)
+            varsig[j + 1] = varsig[j];
+        varsig[j + 1] = v;
+    }
+
+    print "/* Generated from pysigmap.h by sighash.awk, include after it */";
+    print "";
+    printf("#define PY_SIGHASH_BUCKETS %d\n", buckets);
+    printf("#define PY_SIGHASH_SIZE %d\n", size);
+    print "";
+    print "static const unsigned short py_sighash_disp[PY_SIGHASH_BUCKETS] = {";
+    for (b = 0; b < buckets; b++)
+        printf("%s%d%s", (b % 12 == 0)? "    " : "", disp[b], 
+                (b == buckets - 1)? "\n" : ((b % 12 == 11)? ",\n" : ", "));
+    print "};";
+    print "";
+    print "/* index into py_sigmap, -1 for empty slots */";
+    print "static const short py_sighash_slots[PY_SIGHASH_SIZE] = {";
+    for (s = 0; s < size; s++)
+        printf("%s%d%s", (s % 12 == 0)? "    " : "", slot[s], 
+                (s == size - 1)? "\n" : ((s % 12 == 11)? ",\n" : ", "));
+    print "};";
+    print "";
+    print "/* variable signal prefixes, sorted by name */";
+    print "static const short py_sigprefix[] = {";
+    for (i = 0; i < nvar; i++)
+        printf("    %d, /* %s */\n", varsig[i], names[varsig[i]]);
+    print "};";
+    print "";
+    print "#define py_sigprefix_len() (sizeof(py_sigprefix) / sizeof(py_sigprefix[0]))";
+    print "";
+    print "static guint32 py_sighash_str(const char *s, guint32 mult)";
+    print "{";
+    print "    guint32 h = 0;";
+    print "";
+    print "    while (*s)";
+    print "        h = h * mult + (unsigned char)*s++;";
+    print "";
+    print "    return h;";
+    print "}";
+    print "";
+    print "/* built-in signal named name, or NULL */";
+    print "static PY_SIGNAL_SPEC_REC *py_sigmap_find(const char *name)";
+    print "{";
+    print "    guint32 bucket, slot;";
+    print "    int idx;";
+    print "";
+    print "    bucket = py_sighash_str(name, 31) % PY_SIGHASH_BUCKETS;";
+    print "    slot = py_sighash_str(name, 31 + 2 * py_sighash_disp[bucket]) % PY_SIGHASH_SIZE;";
+    print "    idx = py_sighash_slots[slot];";
+    print "";
+    print "    if (idx >= 0 && strcmp(py_sigmap[idx].name, name) == 0)";
+    print "        return &py_sigmap[idx];";
+    print "";
+    print "    return NULL;";
+    print "}";
+    print "";
+    print "/* built-in variable signal whose prefix begins name, or NULL */";
+    print "static PY_SIGNAL_SPEC_REC *py_sigmap_find_prefix(const char *name)";
+    print "{";
+    print "    int lo = 0, hi = py_sigprefix_len(), i;";
+    print "";
+    print "    /* find the last prefix <= name */";
+    print "    while (lo < hi)";
+    print "    {";
+    print "        int mid = (lo + hi) / 2;";
+    print "";
+    print "        if (strcmp(py_sigmap[py_sigprefix[mid]].name, name) <= 0)";
+    print "            lo = mid + 1;";
+    print "        else";
+    print "            hi = mid;";
+    print "    }";
+    print "";
+    print "    /* a shorter prefix of name may sort before a longer non-matching one */";
+    print "    for (i = lo - 1; i >= 0; i--)";
+    print "    {";
+    print "        PY_SIGNAL_SPEC_REC *spec = &py_sigmap[py_sigprefix[i]];";
+    print "";
+    print "        if (strncmp(spec->name, name, strlen(spec->name)) == 0)";
+    print "            return spec;";
+    print "        if (spec->name[0] != name[0])";
+    print "            break;";
+    print "    }";
+    print "";
+    print "    return NULL;";
+    print "}";
+}